@@ -0,0 +1,493 @@
+/*------------------------------------------------------------------------------
+Part of the MQSS Project, under the Apache License v2.0 with LLVM Exceptions.
+See https://llvm.org/LICENSE.txt for license information.
+SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+------------------------------------------------------------------------------*/
+
+#include "qinfo.h"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// Distributions of the key lengths of the generated keys.
+enum KeyLength : int64_t {
+  SHORT = 0,  ///< Keys of up to 15 characters, which are stored inline.
+  MEDIUM = 1, ///< Keys of about 32 characters.
+  LONG = 2,   ///< Keys of about 128 characters.
+  MIXED = 3   ///< Keys of all of the above lengths in equal parts.
+};
+
+const std::vector<int64_t> SIZES = {10, 100, 1000, 10000, 100000, 1000000};
+const std::vector<int64_t> LENGTHS = {SHORT, MEDIUM, LONG, MIXED};
+
+std::string makeKey(const std::size_t i, const int64_t length) {
+  switch (length == MIXED ? static_cast<int64_t>(i % 3) : length) {
+  case SHORT:
+    return "k" + std::to_string(i);
+  case MEDIUM: {
+    std::string key = "device.qubit." + std::to_string(i) + ".calibration";
+    key.resize(32, '_');
+    return key;
+  }
+  default: {
+    std::string key = "device.coupling.map." + std::to_string(i) + ".";
+    key.resize(128, 'x');
+    return key;
+  }
+  }
+}
+
+/// Returns @p size distinct keys, cached across benchmarks.
+const std::vector<std::string> &keys(const int64_t size, const int64_t length) {
+  static std::map<std::pair<int64_t, int64_t>, std::vector<std::string>> cache;
+  std::vector<std::string> &result = cache[{size, length}];
+  if (result.empty()) {
+    result.reserve(static_cast<std::size_t>(size));
+    for (std::size_t i = 0; i < static_cast<std::size_t>(size); ++i) {
+      result.push_back(makeKey(i, length));
+    }
+  }
+  return result;
+}
+
+/// Returns the indices 0 to @p size - 1 in a fixed random order.
+std::vector<std::size_t> shuffled(const int64_t size) {
+  std::vector<std::size_t> order(static_cast<std::size_t>(size));
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+  return order;
+}
+
+/// Creates a QInfo object with the given keys and integer values.
+QInfo makeInfo(const std::vector<std::string> &names) {
+  QInfo info = nullptr;
+  QInfo_create_with_capacity(&info, static_cast<int>(names.size()));
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    QInfo_index index = 0;
+    QInfo_add(info, names[i].c_str(), QINFO_TYPE_INT32, &index);
+    QInfo_set_i32(info, index, static_cast<int32_t>(i));
+  }
+  return info;
+}
+
+void sizesAndLengths(benchmark::internal::Benchmark *b) {
+  b->ArgsProduct({SIZES, LENGTHS})->ArgNames({"size", "keys"});
+}
+
+void sizes(benchmark::internal::Benchmark *b) {
+  b->ArgsProduct({SIZES})->ArgNames({"size"});
+}
+
+// --- object lifetime ---------------------------------------------------------
+
+void BM_CreateFree(benchmark::State &state) {
+  for (auto _ : state) {
+    QInfo info = nullptr;
+    QInfo_create(&info);
+    benchmark::DoNotOptimize(info);
+    QInfo_free(info);
+  }
+}
+BENCHMARK(BM_CreateFree);
+
+void BM_AcquireRelease(benchmark::State &state) {
+  for (auto _ : state) {
+    QInfo info = nullptr;
+    QInfo_acquire(&info);
+    benchmark::DoNotOptimize(info);
+    QInfo_release(info);
+  }
+  QInfo_pool_drain();
+}
+BENCHMARK(BM_AcquireRelease);
+
+// --- adding keys -------------------------------------------------------------
+
+/// Fills an empty object, growing it geometrically.
+void BM_Add(benchmark::State &state) {
+  const auto &names = keys(state.range(0), state.range(1));
+  for (auto _ : state) {
+    QInfo info = nullptr;
+    QInfo_create(&info);
+    for (const std::string &name : names) {
+      QInfo_index index = 0;
+      QInfo_add(info, name.c_str(), QINFO_TYPE_INT32, &index);
+    }
+    state.PauseTiming();
+    QInfo_free(info);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Add)->Apply(sizesAndLengths);
+
+/// Fills an object presized for all keys, so that it never reallocates.
+void BM_AddReserved(benchmark::State &state) {
+  const auto &names = keys(state.range(0), state.range(1));
+  for (auto _ : state) {
+    QInfo info = nullptr;
+    QInfo_create_with_capacity(&info, static_cast<int>(names.size()));
+    for (const std::string &name : names) {
+      QInfo_index index = 0;
+      QInfo_add(info, name.c_str(), QINFO_TYPE_INT32, &index);
+    }
+    state.PauseTiming();
+    QInfo_free(info);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddReserved)->Apply(sizesAndLengths);
+
+/// Fills an object with QInfo_add_many.
+void BM_AddMany(benchmark::State &state) {
+  const auto &names = keys(state.range(0), state.range(1));
+  std::vector<const char *> pointers;
+  for (const std::string &name : names) {
+    pointers.push_back(name.c_str());
+  }
+  const std::vector<QINFO_TYPE> types(names.size(), QINFO_TYPE_INT32);
+  std::vector<QInfo_index> indices(names.size());
+  for (auto _ : state) {
+    QInfo info = nullptr;
+    QInfo_create(&info);
+    QInfo_add_many(info, names.size(), pointers.data(), types.data(),
+                   indices.data());
+    state.PauseTiming();
+    QInfo_free(info);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddMany)->Apply(sizesAndLengths);
+
+// --- lookups -----------------------------------------------------------------
+
+void BM_QueryHit(benchmark::State &state) {
+  const auto &names = keys(state.range(0), state.range(1));
+  const std::vector<std::size_t> order = shuffled(state.range(0));
+  QInfo info = makeInfo(names);
+  std::size_t next = 0;
+  for (auto _ : state) {
+    QInfo_index index = 0;
+    QInfo_query(info, names[order[next]].c_str(), &index);
+    benchmark::DoNotOptimize(index);
+    next = next + 1 == order.size() ? 0 : next + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+  QInfo_free(info);
+}
+BENCHMARK(BM_QueryHit)->Apply(sizesAndLengths);
+
+void BM_QueryMiss(benchmark::State &state) {
+  const auto &names = keys(state.range(0), state.range(1));
+  std::vector<std::string> missing;
+  for (const std::string &name : keys(std::min<int64_t>(state.range(0), 1024),
+                                      state.range(1))) {
+    missing.push_back(name + "?");
+  }
+  QInfo info = makeInfo(names);
+  std::size_t next = 0;
+  for (auto _ : state) {
+    QInfo_index index = 0;
+    benchmark::DoNotOptimize(
+        QInfo_query(info, missing[next].c_str(), &index));
+    next = next + 1 == missing.size() ? 0 : next + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+  QInfo_free(info);
+}
+BENCHMARK(BM_QueryMiss)->Apply(sizesAndLengths);
+
+/// Looks up prehashed keys and reads their values.
+void BM_QueryKeyAndGet(benchmark::State &state) {
+  const auto &names = keys(state.range(0), MEDIUM);
+  const std::vector<std::size_t> order = shuffled(state.range(0));
+  std::vector<QInfo_key> handles(names.size());
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    QInfo_key_make(names[i].c_str(), names[i].size(), &handles[i]);
+  }
+  QInfo info = makeInfo(names);
+  std::size_t next = 0;
+  for (auto _ : state) {
+    QInfo_index index = 0;
+    QInfo_query_key(info, &handles[order[next]], &index);
+    int32_t value = 0;
+    QInfo_get_val_i32(info, index, &value);
+    benchmark::DoNotOptimize(value);
+    next = next + 1 == order.size() ? 0 : next + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+  QInfo_free(info);
+}
+BENCHMARK(BM_QueryKeyAndGet)->Apply(sizes);
+
+/// Reads values from a concurrent object on several threads at once.
+void BM_ConcurrentQuery(benchmark::State &state) {
+  static QInfo info = nullptr;
+  const auto &names = keys(10000, MEDIUM);
+  if (state.thread_index() == 0) {
+    QInfo_create_concurrent(&info);
+    for (const std::string &name : names) {
+      QInfo_index index = 0;
+      QInfo_add(info, name.c_str(), QINFO_TYPE_INT32, &index);
+    }
+  }
+  std::size_t next = static_cast<std::size_t>(state.thread_index()) * 997;
+  for (auto _ : state) {
+    QInfo_index index = 0;
+    QInfo_query(info, names[next % names.size()].c_str(), &index);
+    int32_t value = 0;
+    QInfo_get_val_i32(info, index, &value);
+    benchmark::DoNotOptimize(value);
+    next += 7919;
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    QInfo_free(info);
+  }
+}
+BENCHMARK(BM_ConcurrentQuery)->ThreadRange(1, 8)->UseRealTime();
+
+// --- modification ------------------------------------------------------------
+
+/// Removes a key and adds it again, so that the size of the object is stable.
+void BM_RemoveChurn(benchmark::State &state) {
+  const auto &names = keys(state.range(0), MEDIUM);
+  const std::vector<std::size_t> order = shuffled(state.range(0));
+  QInfo info = makeInfo(names);
+  std::size_t next = 0;
+  for (auto _ : state) {
+    const char *name = names[order[next]].c_str();
+    QInfo_index index = 0;
+    QInfo_query(info, name, &index);
+    QInfo_remove(info, index);
+    QInfo_add(info, name, QINFO_TYPE_INT32, &index);
+    next = next + 1 == order.size() ? 0 : next + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+  QInfo_free(info);
+}
+BENCHMARK(BM_RemoveChurn)->Apply(sizes);
+
+void BM_Iterate(benchmark::State &state) {
+  QInfo info = makeInfo(keys(state.range(0), MEDIUM));
+  for (auto _ : state) {
+    int64_t sum = 0;
+    for (QInfo_iterator it = QInfo_begin(info); it != QInfo_end(info);
+         QInfo_next(info, &it)) {
+      int32_t value = 0;
+      QInfo_get_val_i32(info, it, &value);
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  QInfo_free(info);
+}
+BENCHMARK(BM_Iterate)->Apply(sizes);
+
+void BM_Duplicate(benchmark::State &state) {
+  QInfo info = makeInfo(keys(state.range(0), MEDIUM));
+  for (auto _ : state) {
+    QInfo copy = nullptr;
+    QInfo_duplicate(info, &copy);
+    benchmark::DoNotOptimize(copy);
+    QInfo_free(copy);
+  }
+  QInfo_free(info);
+}
+BENCHMARK(BM_Duplicate)->Apply(sizes);
+
+/// Duplicates an object and overrides one of its values.
+void BM_DuplicateAndSet(benchmark::State &state) {
+  QInfo info = makeInfo(keys(state.range(0), MEDIUM));
+  for (auto _ : state) {
+    QInfo copy = nullptr;
+    QInfo_duplicate(info, &copy);
+    QInfo_set_i32(copy, QInfo_begin(copy), 1);
+    QInfo_free(copy);
+  }
+  QInfo_free(info);
+}
+BENCHMARK(BM_DuplicateAndSet)->Apply(sizes);
+
+/// Creates a layered object over a shared default and overrides one value.
+void BM_LayeredAndAdd(benchmark::State &state) {
+  QInfo info = makeInfo(keys(state.range(0), MEDIUM));
+  for (auto _ : state) {
+    QInfo child = nullptr;
+    QInfo_create_layered(info, &child);
+    QInfo_index index = 0;
+    QInfo_add(child, "shots", QINFO_TYPE_INT32, &index);
+    QInfo_free(child);
+  }
+  QInfo_free(info);
+}
+BENCHMARK(BM_LayeredAndAdd)->Apply(sizes);
+
+void BM_Merge(benchmark::State &state) {
+  QInfo info = makeInfo(keys(state.range(0), MEDIUM));
+  for (auto _ : state) {
+    QInfo dst = nullptr;
+    QInfo_create(&dst);
+    QInfo_merge(dst, info, QINFO_MERGE_OVERWRITE);
+    state.PauseTiming();
+    QInfo_free(dst);
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  QInfo_free(info);
+}
+BENCHMARK(BM_Merge)->Apply(sizes);
+
+// --- string values -----------------------------------------------------------
+
+const std::vector<int64_t> VALUE_LENGTHS = {8, 64, 1024};
+
+void BM_SetString(benchmark::State &state) {
+  const std::string first(static_cast<std::size_t>(state.range(0)), 'a');
+  const std::string second(static_cast<std::size_t>(state.range(0)), 'b');
+  QInfo info = nullptr;
+  QInfo_create(&info);
+  QInfo_index index = 0;
+  QInfo_add(info, "value", QINFO_TYPE_STRING, &index);
+  bool flip = false;
+  for (auto _ : state) {
+    QInfo_set_c(info, index, flip ? first.c_str() : second.c_str());
+    flip = !flip;
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+  QInfo_free(info);
+}
+BENCHMARK(BM_SetString)->ArgsProduct({VALUE_LENGTHS})->ArgNames({"length"});
+
+/// Gets a string value as a copy owned by the caller.
+void BM_GetString(benchmark::State &state) {
+  const std::string value(static_cast<std::size_t>(state.range(0)), 'a');
+  QInfo info = nullptr;
+  QInfo_create(&info);
+  QInfo_index index = 0;
+  QInfo_add(info, "value", QINFO_TYPE_STRING, &index);
+  QInfo_set_c(info, index, value.c_str());
+  for (auto _ : state) {
+    char *copy = nullptr;
+    QInfo_get_val_c(info, index, &copy);
+    benchmark::DoNotOptimize(copy);
+    free(copy);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+  QInfo_free(info);
+}
+BENCHMARK(BM_GetString)->ArgsProduct({VALUE_LENGTHS})->ArgNames({"length"});
+
+/// Gets a string value without copying it.
+void BM_PeekString(benchmark::State &state) {
+  const std::string value(static_cast<std::size_t>(state.range(0)), 'a');
+  QInfo info = nullptr;
+  QInfo_create(&info);
+  QInfo_index index = 0;
+  QInfo_add(info, "value", QINFO_TYPE_STRING, &index);
+  QInfo_set_c(info, index, value.c_str());
+  for (auto _ : state) {
+    const char *data = nullptr;
+    std::size_t length = 0;
+    QInfo_peek_val_c(info, index, &data, &length);
+    benchmark::DoNotOptimize(data);
+    benchmark::DoNotOptimize(length);
+  }
+  QInfo_free(info);
+}
+BENCHMARK(BM_PeekString)->ArgsProduct({VALUE_LENGTHS})->ArgNames({"length"});
+
+// --- frozen objects and serialization ----------------------------------------
+
+void BM_FrozenQuery(benchmark::State &state) {
+  const auto &names = keys(state.range(0), MEDIUM);
+  const std::vector<std::size_t> order = shuffled(state.range(0));
+  QInfo info = makeInfo(names);
+  QInfo_frozen frozen = nullptr;
+  QInfo_freeze(info, &frozen);
+  std::size_t next = 0;
+  for (auto _ : state) {
+    QInfo_index index = 0;
+    QInfo_frozen_query(frozen, names[order[next]].c_str(), &index);
+    benchmark::DoNotOptimize(index);
+    next = next + 1 == order.size() ? 0 : next + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+  QInfo_frozen_free(frozen);
+  QInfo_free(info);
+}
+BENCHMARK(BM_FrozenQuery)->Apply(sizes);
+
+std::vector<char> serialize(QInfo info) {
+  std::size_t size = 0;
+  QInfo_serialize(info, nullptr, 0, &size);
+  std::vector<char> buffer(size);
+  QInfo_serialize(info, buffer.data(), buffer.size(), &size);
+  return buffer;
+}
+
+void BM_Serialize(benchmark::State &state) {
+  QInfo info = makeInfo(keys(state.range(0), state.range(1)));
+  std::vector<char> buffer = serialize(info);
+  for (auto _ : state) {
+    std::size_t size = 0;
+    QInfo_serialize(info, buffer.data(), buffer.size(), &size);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(buffer.size()));
+  QInfo_free(info);
+}
+BENCHMARK(BM_Serialize)->Apply(sizesAndLengths);
+
+void BM_Deserialize(benchmark::State &state) {
+  QInfo info = makeInfo(keys(state.range(0), state.range(1)));
+  const std::vector<char> buffer = serialize(info);
+  QInfo_free(info);
+  for (auto _ : state) {
+    QInfo copy = nullptr;
+    QInfo_deserialize(buffer.data(), buffer.size(), &copy);
+    state.PauseTiming();
+    QInfo_free(copy);
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(buffer.size()));
+}
+BENCHMARK(BM_Deserialize)->Apply(sizesAndLengths);
+
+void BM_LoadBuffer(benchmark::State &state) {
+  std::string text;
+  for (const std::string &name : keys(state.range(0), MEDIUM)) {
+    text += name + ":f64 = 1.25e-4\n";
+  }
+  for (auto _ : state) {
+    QInfo info = nullptr;
+    QInfo_create(&info);
+    QInfo_load_buffer(info, text.data(), text.size(), nullptr);
+    state.PauseTiming();
+    QInfo_free(info);
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(text.size()));
+}
+BENCHMARK(BM_LoadBuffer)->Apply(sizes);
+
+} // namespace
+
+BENCHMARK_MAIN();
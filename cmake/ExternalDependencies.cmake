@@ -27,5 +27,31 @@ if(BUILD_QINFO_TESTS)
   endif()
 endif()
 
+if(BUILD_QINFO_BENCHMARKS)
+  set(BENCHMARK_ENABLE_TESTING
+      OFF
+      CACHE BOOL "" FORCE)
+  set(BENCHMARK_ENABLE_INSTALL
+      OFF
+      CACHE BOOL "" FORCE)
+  set(BENCHMARK_VERSION
+      1.7.1
+      CACHE STRING "Google Benchmark version")
+  set(BENCHMARK_URL
+      https://github.com/google/benchmark/archive/refs/tags/v${BENCHMARK_VERSION}.tar.gz
+  )
+  if(CMAKE_VERSION VERSION_GREATER_EQUAL 3.24)
+    FetchContent_Declare(benchmark URL ${BENCHMARK_URL} FIND_PACKAGE_ARGS
+                                       ${BENCHMARK_VERSION})
+    list(APPEND FETCH_PACKAGES benchmark)
+  else()
+    find_package(benchmark ${BENCHMARK_VERSION} QUIET)
+    if(NOT benchmark_FOUND)
+      FetchContent_Declare(benchmark URL ${BENCHMARK_URL})
+      list(APPEND FETCH_PACKAGES benchmark)
+    endif()
+  endif()
+endif()
+
 # Make all declared dependencies available.
 FetchContent_MakeAvailable(${FETCH_PACKAGES})
@@ -11,6 +11,7 @@ SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -21,6 +22,7 @@ extern "C" {
  * @brief Status codes returned by the API.
  */
 enum QINFO_STATUS {
+  QINFO_WARN_MISMATCH = 3,
   QINFO_WARN_NOKEY = 2,
   QINFO_WARN_GENERAL = 1,
   QINFO_SUCCESS = 0,
@@ -28,7 +30,9 @@ enum QINFO_STATUS {
   QINFO_ERROR_OUTOFMEM = -2,
   QINFO_ERROR_KEYEXISTS = -3,
   QINFO_ERROR_OUTOFBOUNDS = -4,
-  QINFO_ERROR_INVALIDTYPE = -5
+  QINFO_ERROR_INVALIDTYPE = -5,
+  QINFO_ERROR_INVALIDFORMAT = -6,
+  QINFO_ERROR_IO = -7
 };
 
 /**
@@ -67,15 +71,31 @@ enum QINFO_TYPE {
   QINFO_TYPE_INT64 = 1,
   QINFO_TYPE_FLOAT = 2,
   QINFO_TYPE_DOUBLE = 3,
-  QINFO_TYPE_STRING = 4
+  QINFO_TYPE_STRING = 4,
+  QINFO_TYPE_INT32_ARRAY = 5,
+  QINFO_TYPE_INT64_ARRAY = 6,
+  QINFO_TYPE_FLOAT_ARRAY = 7,
+  QINFO_TYPE_DOUBLE_ARRAY = 8,
+  QINFO_TYPE_BLOB = 9,
+  QINFO_TYPE_QINFO = 10
+};
+
+/**
+ * @brief Policies for keys present in both objects passed to QInfo_merge.
+ */
+enum QINFO_MERGE_POLICY {
+  QINFO_MERGE_OVERWRITE = 0, /**< The value of the source object is taken. */
+  QINFO_MERGE_KEEP = 1,      /**< The value of the destination is kept. */
+  QINFO_MERGE_ERROR = 2      /**< The merge fails without changes. */
 };
 
 /**
  * @brief A container for unordered key-value pairs with heterogeneous values.
  * @details QInfo is a container for unordered key-value pairs with
  * heterogeneous values. The keys are strings and the values can be integers,
- * longs, floats, doubles, or strings. The keys are unique within a QInfo
- * object. The values can be accessed using the key or the index of the
+ * longs, floats, doubles, strings, arrays of integers, longs, floats, or
+ * doubles, binary blobs, or nested QInfo objects. The keys are unique within
+ * a QInfo object. The values can be accessed using the key or the index of the
  * key-value pair.
  * @note The QInfo object is realized as an opaque pointer to a struct. The user
  * should not access the members of the struct directly. The user should use the
@@ -93,6 +113,80 @@ typedef int QInfo_index;
  */
 typedef QInfo_index QInfo_iterator;
 
+/**
+ * @brief A precomputed key.
+ * @details A key handle caches the length and the hash of a key, so that
+ * repeated calls to QInfo_add_key and QInfo_query_key with the same key skip
+ * both. Key handles are independent of any QInfo object and can be used with
+ * all of them. Key handles must be created with QInfo_key_make and their
+ * members must not be modified.
+ * @note A key handle does not own the characters of the key. They must remain
+ * valid and unchanged for as long as the handle is used.
+ */
+typedef struct QInfo_key_d {
+  const char *data; /**< The characters of the key. */
+  size_t length;    /**< The length of the key in bytes. */
+  uint64_t hash;    /**< The hash of the key. */
+} QInfo_key;
+
+/**
+ * @brief An immutable, compiled form of a QInfo object.
+ * @details A frozen QInfo object is created with QInfo_freeze and holds a
+ * snapshot of the key-value pairs of a QInfo object in a single allocation.
+ * Keys are looked up through a minimal perfect hash, so that a lookup touches
+ * one bucket pilot and one entry. The indices of a frozen object range from 0
+ * to QInfo_frozen_size() - 1. Frozen objects can be saved to snapshot files
+ * and mapped back into memory with QInfo_open_mapped.
+ * @note A frozen object is never modified. It can be shared between threads
+ * and used concurrently without any synchronization.
+ */
+typedef const struct QInfo_frozen_impl_d *QInfo_frozen;
+
+/**
+ * @brief Memory allocation callbacks for a QInfo object.
+ * @details All storage of a QInfo object created with
+ * QInfo_create_with_allocator is obtained from these callbacks: the object
+ * itself, its value space, its hash index, and its keys and string values.
+ * Each callback receives @p context as its first argument. Returned memory
+ * must be suitably aligned for any type, like memory returned by malloc.
+ */
+typedef struct QInfo_allocator_d {
+  /** Allocates @p size bytes, or returns NULL on failure. Required. */
+  void *(*alloc)(void *context, size_t size);
+  /**
+   * Resizes the block @p ptr to @p size bytes, preserving its first @p used
+   * bytes, or returns NULL on failure and leaves @p ptr unchanged. May be
+   * NULL, in which case a new block is allocated and the data is copied.
+   */
+  void *(*realloc)(void *context, void *ptr, size_t used, size_t size);
+  /**
+   * Releases the block @p ptr. May be NULL, if memory is reclaimed in bulk
+   * when it is no longer needed.
+   */
+  void (*free)(void *context, void *ptr);
+  void *context; /**< User data passed to the callbacks. */
+} QInfo_allocator;
+
+/**
+ * @brief Usage statistics of a QInfo object, see QInfo_get_stats.
+ * @details The memory footprint is always reported. The operation counters
+ * are only maintained if the library was built with QINFO_ENABLE_STATS, and
+ * are zero otherwise.
+ */
+typedef struct QInfo_stats_d {
+  int instrumented; /**< Whether the operation counters are maintained. */
+  uint64_t lookups; /**< Number of key lookups in the hash index. */
+  uint64_t hits;    /**< Number of lookups that found the key. */
+  uint64_t misses;  /**< Number of lookups that did not find the key. */
+  uint64_t probes;  /**< Number of buckets inspected by all lookups. */
+  uint64_t max_probe;   /**< Largest number of buckets inspected by a lookup. */
+  uint64_t growths;     /**< Number of times the storage grew. */
+  uint64_t allocations; /**< Number of allocations and reallocations. */
+  size_t live_bytes;    /**< Bytes of storage currently held by the object. */
+  size_t shared_bytes;  /**< Part of @p live_bytes shared with other objects. */
+  size_t peak_bytes;    /**< Largest value of @p live_bytes observed. */
+} QInfo_stats;
+
 /**
  * @brief Creates a new QInfo object.
  * @details This function creates a new QInfo object. The newly created object
@@ -107,24 +201,292 @@ typedef QInfo_index QInfo_iterator;
  */
 int QInfo_create(QInfo *info);
 
+/**
+ * @brief Creates a new QInfo object with room for @p capacity entries.
+ * @details Behaves like QInfo_create, but preallocates storage such that the
+ * first @p capacity calls to QInfo_add do not need to allocate any further
+ * storage for the entries themselves.
+ * @param[out] info QInfo object created (handle).
+ * @param[in] capacity Number of entries to preallocate storage for.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_create
+ * @see QInfo_reserve
+ */
+int QInfo_create_with_capacity(QInfo *info, int capacity);
+
+/**
+ * @brief Creates a new QInfo object whose storage is managed by
+ * @p allocator.
+ * @details The callbacks are copied into the object and used for all of its
+ * storage, see QInfo_allocator. Duplicates of the object use the same
+ * callbacks. Strings shared with another object by QInfo_merge are released
+ * with the callbacks of the object that allocated them.
+ * @param[out] info QInfo object created (handle).
+ * @param[in] capacity Number of entries to reserve storage for.
+ * @param[in] allocator Allocation callbacks, or NULL for malloc and free.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The context of @p allocator must remain valid until the object, all
+ * of its duplicates, and all objects merged with it have been freed. Strings
+ * returned by QInfo_get_key and QInfo_get_val_c, and frozen objects created
+ * from the object, are still allocated with malloc.
+ *
+ * @see QInfo_create_with_capacity
+ */
+int QInfo_create_with_allocator(QInfo *info, int capacity,
+                                const QInfo_allocator *allocator);
+
+/**
+ * @brief Creates a new QInfo object that may be used from several threads.
+ * @details Behaves like QInfo_create, but every API call on the object is
+ * synchronized internally. Any number of threads may query and get values in
+ * parallel without contending with each other. Calls that modify the object
+ * wait until running reads have finished and block new reads meanwhile.
+ * @param[out] info QInfo object created (handle).
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note Each call is atomic on its own. An index obtained by one call may
+ * refer to a different entry in a later call if another thread removed and
+ * added keys in between. Pointers returned by the peek functions are only
+ * guaranteed to remain valid until another thread modifies the object, so
+ * concurrent readers should use QInfo_get_key and QInfo_get_val_c instead.
+ * QInfo_free must not run concurrently with any other call on the object.
+ * Objects created by QInfo_duplicate from a concurrent object are not
+ * concurrent.
+ *
+ * @see QInfo_create
+ */
+int QInfo_create_concurrent(QInfo *info);
+
+/**
+ * @brief Creates a new, empty QInfo object that falls back to @p parent for
+ * keys it does not contain itself.
+ * @details The child holds only its own entries, which override entries of
+ * @p parent with the same key. QInfo_query, the getters and the peek
+ * functions resolve keys and indices through the chain of ancestors without
+ * copying their entries. Indices of inherited entries encode the ancestor
+ * they refer to. They are valid for the child only and must not be used to
+ * modify entries: QInfo_remove, the setters and the atomic functions accept
+ * only indices of the child's own entries. To change an inherited value, add
+ * the key to the child. Iteration, QInfo_empty, QInfo_merge, serialization
+ * and freezing consider only the child's own entries, see QInfo_flatten.
+ * @param[in] parent QInfo object (handle) to fall back to. It may be layered
+ * itself.
+ * @param[out] child QInfo object created (handle).
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_OUTOFBOUNDS if @p parent
+ * already has 127 ancestors, an error code otherwise.
+ * @note @p parent is not copied and must outlive @p child. It may be modified
+ * in between, and the child observes the changes. A layered object holds at
+ * most 2^24 entries, and a lookup through the chain returns
+ * QINFO_ERROR_OUTOFBOUNDS for an inherited entry at an index beyond that.
+ * Objects created by QInfo_duplicate from a layered object have the same
+ * parent.
+ *
+ * @see QInfo_flatten
+ */
+int QInfo_create_layered(QInfo parent, QInfo *child);
+
+/**
+ * @brief Creates a new QInfo object with the entries of @p info and of all of
+ * its ancestors.
+ * @details Where a key occurs in several layers, the entry of the layer
+ * closest to @p info is taken. The flattened object has no parent. The root
+ * of the chain is duplicated and the other layers are merged into the copy,
+ * so that the time taken depends only on the number of entries of the layers
+ * other than the root.
+ * @param[in] info QInfo object (handle) to flatten.
+ * @param[out] flat QInfo object created (handle).
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_create_layered
+ */
+int QInfo_flatten(QInfo info, QInfo *flat);
+
 /**
  * @brief Create a new QInfo object as a copy of an existing QInfo object.
  * @details This function duplicates an existing info object, creating a new
  * info object with the same key-value pairs and the same ordering of keys.
+ * The duplicate shares its storage with @p info_in and takes constant time.
+ * Storage is copied lazily when either object is modified: a modification
+ * copies only the affected page of 64 entries, and adding or removing keys
+ * additionally copies the hash index once. Keys and string values are never
+ * copied. Both objects remain fully independent and may be freed in any order.
+ * Nested QInfo values are duplicated in turn, which takes time linear in the
+ * number of nested objects.
  * @param[in] info_in QInfo object (handle) to duplicate.
  * @param[out] info_out QInfo object (handle) created as a copy of @p info_in.
  * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note Objects sharing storage may be used from different threads. Calls on
+ * the same object, including QInfo_duplicate, must not run concurrently
+ * unless it was created with QInfo_create_concurrent.
  */
 int QInfo_duplicate(QInfo info_in, QInfo *info_out);
 
 /**
  * @brief Frees a QInfo object.
- * @details This function frees @p info and sets it to QINFO_NULL.
+ * @details This function frees @p info and sets it to QINFO_NULL. Nested
+ * QInfo values of @p info are freed as well.
  * @param[in,out] info QInfo object (handle).
- * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @return QINFO_SUCCESS on success, an error code otherwise. In particular,
+ * QINFO_ERROR_INVALIDTYPE if @p info is the value of an entry of another
+ * object, which owns and eventually frees it.
  */
 int QInfo_free(QInfo info);
 
+/**
+ * @brief Removes all entries from @p info, but retains its capacity.
+ * @details The value space, the hash index and the largest block of string
+ * storage are kept, so that refilling @p info with up to as many entries as
+ * before performs no allocations. Indices of removed entries become invalid.
+ * @param[in,out] info QInfo object (handle).
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The parent of a layered object is not affected.
+ */
+int QInfo_clear(QInfo info);
+
+/**
+ * @brief Takes an empty QInfo object from the recycling pool of the calling
+ * thread, or creates one if the pool is empty.
+ * @details Pooled objects keep the capacity of their previous use, so that
+ * a thread that repeatedly acquires, fills and releases objects of similar
+ * size performs no allocations once the pool is warm.
+ * @param[out] info QInfo object (handle).
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_release
+ */
+int QInfo_acquire(QInfo *info);
+
+/**
+ * @brief Clears @p info and returns it to the recycling pool of the calling
+ * thread.
+ * @details The pool holds up to 8 objects per thread. Objects that do not fit,
+ * concurrent and layered objects, and objects with a custom allocator are
+ * freed instead. Any QInfo object may be released, not only those obtained
+ * from QInfo_acquire, and an object may be released on another thread than
+ * the one that acquired it.
+ * @param[in] info QInfo object (handle). It must not be used afterwards.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note Pooled objects are not freed when a thread exits. Threads that use
+ * the pool should call QInfo_pool_drain before they exit.
+ *
+ * @see QInfo_acquire
+ */
+int QInfo_release(QInfo info);
+
+/**
+ * @brief Frees all objects in the recycling pool of the calling thread.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_pool_drain(void);
+
+/**
+ * @brief Reserves storage in @p info for at least @p capacity entries.
+ * @details If @p capacity is larger than the current capacity, the storage is
+ * grown in a single step. Otherwise, this function does nothing. Indices of
+ * existing entries remain valid.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] capacity Total number of entries to reserve storage for.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_reserve(QInfo info, int capacity);
+
+/**
+ * @brief Reclaims the memory of removed and overwritten strings in @p info.
+ * @details Keys and string values of a QInfo object are stored in an
+ * object-local arena. Memory of removed keys and overwritten string values is
+ * reused for later strings of the same size where possible, and otherwise only
+ * reclaimed by this function, which moves all live strings into a single
+ * block.
+ * @param[in,out] info QInfo object (handle).
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note This function invalidates all pointers obtained from QInfo_peek_key
+ * and QInfo_peek_val_c for @p info.
+ *
+ * @see QInfo_get_arena_usage
+ */
+int QInfo_compact(QInfo info);
+
+/**
+ * @brief Reports the memory used for keys and string values of @p info.
+ * @param[in] info QInfo object (handle).
+ * @param[out] live Number of bytes holding live keys and string values. May be
+ * NULL.
+ * @param[out] wasted Number of bytes of removed or overwritten strings that
+ * have not been reused yet. May be NULL.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note Strings written before the last call to QInfo_duplicate are shared
+ * with the duplicate and not counted.
+ *
+ * @see QInfo_compact
+ */
+int QInfo_get_arena_usage(QInfo info, size_t *live, size_t *wasted);
+
+/**
+ * @brief Reports the operation counters and the memory footprint of @p info.
+ * @details The footprint covers the object itself, its value space, its hash
+ * index and all of its keys and string values, including storage shared with
+ * duplicates and merged objects. Lookups are counted by QInfo_query, by the
+ * functions that add keys, and by QInfo_merge. Growth events are counted when
+ * the value space or the hash index is enlarged. The peak footprint is sampled
+ * whenever the storage grows.
+ * @param[in] info QInfo object (handle).
+ * @param[out] stats Statistics of the object.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note Counters of layered objects only cover lookups in the object itself.
+ * Duplicates start with cleared counters.
+ *
+ * @see QInfo_get_arena_usage
+ */
+int QInfo_get_stats(QInfo info, QInfo_stats *stats);
+
+/**
+ * @brief Starts or stops recording how often each key of @p info is looked
+ * up.
+ * @details While profiling, every successful QInfo_query and QInfo_query_many
+ * counts a lookup for the key found. Counts of removed keys are dropped.
+ * Starting an already running profile keeps its counts, stopping it discards
+ * them.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] enable Non-zero to start profiling, zero to stop.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note Duplicates of a profiled object are not profiled.
+ *
+ * @see QInfo_get_hot_keys
+ * @see QInfo_optimize
+ */
+int QInfo_profile(QInfo info, int enable);
+
+/**
+ * @brief Gets the most frequently looked up keys of a profiled QInfo object.
+ * @details Keys are ordered by descending number of lookups, ties by index.
+ * Keys that were never looked up are omitted.
+ * @param[in] info QInfo object (handle).
+ * @param[in] capacity Maximum number of keys to report.
+ * @param[out] indices Indices of the keys, room for @p capacity entries.
+ * @param[out] counts Numbers of lookups of the keys, room for @p capacity
+ * entries. May be NULL.
+ * @param[out] count Number of keys reported, zero if @p info is not profiled.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_profile
+ */
+int QInfo_get_hot_keys(QInfo info, size_t capacity, QInfo_index *indices,
+                       uint64_t *counts, size_t *count);
+
+/**
+ * @brief Reorders the hash index of a profiled QInfo object for its recorded
+ * access pattern.
+ * @details Within each run of colliding hash buckets, frequently looked up
+ * keys are moved in front of rarely looked up ones, so that lookups of hot
+ * keys inspect fewer buckets and compare fewer keys. Entries keep their
+ * indices. Objects that are not profiled are left unchanged.
+ * @param[in,out] info QInfo object (handle).
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_profile
+ */
+int QInfo_optimize(QInfo info);
+
 /**
  * @brief Adds a new entry to @p info.
  * @details This function adds a new entry to @p info with the key @p key and
@@ -140,6 +502,38 @@ int QInfo_free(QInfo info);
 int QInfo_add(QInfo info, const char *key, enum QINFO_TYPE type,
               QInfo_index *index);
 
+/**
+ * @brief Adds a new entry to @p info with a key of explicit length.
+ * @details Behaves like QInfo_add, but the key is given by its first @p length
+ * characters and need not be null-terminated.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] key Key (not necessarily null-terminated).
+ * @param[in] length Length of the key in bytes.
+ * @param[in] type Type of the value to be stored.
+ * @param[out] index Index of the new entry.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_add
+ */
+int QInfo_add_n(QInfo info, const char *key, size_t length,
+                enum QINFO_TYPE type, QInfo_index *index);
+
+/**
+ * @brief Adds a new entry to @p info with a precomputed key.
+ * @details Behaves like QInfo_add, but does not need to compute the length or
+ * the hash of the key.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] key Key handle created with QInfo_key_make.
+ * @param[in] type Type of the value to be stored.
+ * @param[out] index Index of the new entry.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_add
+ * @see QInfo_key_make
+ */
+int QInfo_add_key(QInfo info, const QInfo_key *key, enum QINFO_TYPE type,
+                  QInfo_index *index);
+
 /**
  * @brief Removes the entry at the index @p index from @p info.
  * @param[in,out] info QInfo object (handle).
@@ -161,6 +555,87 @@ int QInfo_remove(QInfo info, QInfo_index index);
  */
 int QInfo_query(QInfo info, const char *key, QInfo_index *index);
 
+/**
+ * @brief Queries the index of the entry with a key of explicit length.
+ * @details Behaves like QInfo_query, but the key is given by its first
+ * @p length characters and need not be null-terminated.
+ * @param[in] info QInfo object (handle).
+ * @param[in] key Key (not necessarily null-terminated).
+ * @param[in] length Length of the key in bytes.
+ * @param[out] index Index of the entry with the key @p key.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_query
+ */
+int QInfo_query_n(QInfo info, const char *key, size_t length,
+                  QInfo_index *index);
+
+/**
+ * @brief Queries the index of the entry with a precomputed key.
+ * @details Behaves like QInfo_query, but does not need to compute the length
+ * or the hash of the key.
+ * @param[in] info QInfo object (handle).
+ * @param[in] key Key handle created with QInfo_key_make.
+ * @param[out] index Index of the entry with the key @p key.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_query
+ * @see QInfo_key_make
+ */
+int QInfo_query_key(QInfo info, const QInfo_key *key, QInfo_index *index);
+
+/**
+ * @brief Queries an entry nested @p depth levels deep in @p info.
+ * @details Looks up @p keys[0] in @p info, which must hold a nested QInfo
+ * object, then @p keys[1] in that object, and so on. No key strings are
+ * concatenated, and each level is an independent, typically small, hash
+ * lookup. For example, the keys {"device", "qubit_17", "t1"} find the entry
+ * "t1" of the object nested under "qubit_17" of the object under "device".
+ * @param[in] info QInfo object (handle) to start from.
+ * @param[in] depth Number of keys in @p keys, at least 1.
+ * @param[in] keys Keys (null-terminated strings) of the path.
+ * @param[out] leaf Object holding the entry with the last key (borrowed).
+ * @param[out] index Index of that entry in @p leaf.
+ * @return QINFO_SUCCESS on success, QINFO_WARN_NOKEY if a key of the path is
+ * missing or a nested object on the path is unset, QINFO_ERROR_INVALIDTYPE if
+ * an entry on the path does not hold a nested object, an error code
+ * otherwise.
+ * @note @p leaf remains valid as long as the entries on the path are not
+ * modified or removed, like the pointers returned by QInfo_peek_child.
+ *
+ * @see QInfo_peek_child
+ */
+int QInfo_query_path(QInfo info, size_t depth, const char *const *keys,
+                     QInfo *leaf, QInfo_index *index);
+
+/**
+ * @brief Queries a nested entry with precomputed keys.
+ * @details Behaves like QInfo_query_path, but does not need to compute the
+ * lengths or the hashes of the keys.
+ * @param[in] info QInfo object (handle) to start from.
+ * @param[in] depth Number of keys in @p keys, at least 1.
+ * @param[in] keys Key handles of the path created with QInfo_key_make.
+ * @param[out] leaf Object holding the entry with the last key (borrowed).
+ * @param[out] index Index of that entry in @p leaf.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_query_path
+ */
+int QInfo_query_path_keys(QInfo info, size_t depth, const QInfo_key *keys,
+                          QInfo *leaf, QInfo_index *index);
+
+/**
+ * @brief Creates a key handle for the first @p length characters of @p key.
+ * @details Computes the hash of the key once, so that the handle can be passed
+ * to QInfo_add_key and QInfo_query_key any number of times.
+ * @param[in] key Key (not necessarily null-terminated).
+ * @param[in] length Length of the key in bytes.
+ * @param[out] handle Key handle created.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The handle refers to the characters of @p key without copying them.
+ */
+int QInfo_key_make(const char *key, size_t length, QInfo_key *handle);
+
 /**
  * @brief Gets the key stored at the index @p index in @p info.
  * @param[in] info QInfo object (handle).
@@ -171,6 +646,28 @@ int QInfo_query(QInfo info, const char *key, QInfo_index *index);
  */
 int QInfo_get_key(QInfo info, QInfo_index index, char **key);
 
+/**
+ * @brief Gets a borrowed pointer to the key stored at the index @p index in
+ * @p info.
+ * @details Unlike QInfo_get_key, this function does not copy the key. The
+ * returned pointer refers to storage owned by @p info.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] key Null-terminated key stored at the index @p index.
+ * @param[out] length Length of the key in bytes, excluding the terminator. May
+ * be NULL.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until the next call that modifies @p info
+ * (e.g., QInfo_add, QInfo_remove, QInfo_set_c, or QInfo_compact), or until
+ * @p info is freed. Short strings are stored inside the entry itself and may
+ * move when the storage of @p info grows. The caller must not modify or free
+ * the pointer.
+ *
+ * @see QInfo_get_key
+ */
+int QInfo_peek_key(QInfo info, QInfo_index index, const char **key,
+                   size_t *length);
+
 /**
  * @brief Gets the type of the value stored at the index @p index in @p info.
  * @param[in] info QInfo object (handle).
@@ -226,6 +723,29 @@ int QInfo_get_val_d(QInfo info, QInfo_index index, double *val);
  */
 int QInfo_get_val_c(QInfo info, QInfo_index index, char **val);
 
+/**
+ * @brief Gets a borrowed pointer to the string value stored at the index
+ * @p index in @p info.
+ * @details Unlike QInfo_get_val_c, this function does not copy the value. The
+ * returned pointer refers to storage owned by @p info. If no value has been
+ * set yet, @p val is set to NULL and @p length to 0.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Null-terminated value stored at the index @p index.
+ * @param[out] length Length of the value in bytes, excluding the terminator.
+ * May be NULL.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until the next call that modifies @p info
+ * (e.g., QInfo_add, QInfo_remove, QInfo_set_c, or QInfo_compact), or until
+ * @p info is freed. Short strings are stored inside the entry itself and may
+ * move when the storage of @p info grows. The caller must not modify or free
+ * the pointer.
+ *
+ * @see QInfo_get_val_c
+ */
+int QInfo_peek_val_c(QInfo info, QInfo_index index, const char **val,
+                     size_t *length);
+
 /**
  * @brief Sets the integer value stored at the index @p index in @p info.
  * @param[in,out] info QInfo object (handle).
@@ -271,6 +791,524 @@ int QInfo_set_d(QInfo info, QInfo_index index, double val);
  */
 int QInfo_set_c(QInfo info, QInfo_index index, const char *val);
 
+/**
+ * @brief Gets a borrowed pointer to the integer array stored at the index
+ * @p index in @p info.
+ * @details The elements are stored contiguously and aligned to 64 bytes, so
+ * they can be processed with vector instructions without copying them.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_INT32_ARRAY.
+ * @param[out] vals Elements of the array, or NULL if it is empty.
+ * @param[out] count Number of elements.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until the next call that modifies @p info,
+ * like the pointers returned by QInfo_peek_val_c.
+ */
+int QInfo_peek_array_i32(QInfo info, QInfo_index index, const int32_t **vals,
+                         size_t *count);
+
+/**
+ * @brief Gets a borrowed pointer to the long array stored at the index
+ * @p index in @p info.
+ * @details The elements are stored contiguously and aligned to 64 bytes, so
+ * they can be processed with vector instructions without copying them.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_INT64_ARRAY.
+ * @param[out] vals Elements of the array, or NULL if it is empty.
+ * @param[out] count Number of elements.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until the next call that modifies @p info,
+ * like the pointers returned by QInfo_peek_val_c.
+ */
+int QInfo_peek_array_i64(QInfo info, QInfo_index index, const int64_t **vals,
+                         size_t *count);
+
+/**
+ * @brief Gets a borrowed pointer to the float array stored at the index
+ * @p index in @p info.
+ * @details The elements are stored contiguously and aligned to 64 bytes, so
+ * they can be processed with vector instructions without copying them.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_FLOAT_ARRAY.
+ * @param[out] vals Elements of the array, or NULL if it is empty.
+ * @param[out] count Number of elements.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until the next call that modifies @p info,
+ * like the pointers returned by QInfo_peek_val_c.
+ */
+int QInfo_peek_array_f(QInfo info, QInfo_index index, const float **vals,
+                       size_t *count);
+
+/**
+ * @brief Gets a borrowed pointer to the double array stored at the index
+ * @p index in @p info.
+ * @details The elements are stored contiguously and aligned to 64 bytes, so
+ * they can be processed with vector instructions without copying them.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_DOUBLE_ARRAY.
+ * @param[out] vals Elements of the array, or NULL if it is empty.
+ * @param[out] count Number of elements.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until the next call that modifies @p info,
+ * like the pointers returned by QInfo_peek_val_c.
+ */
+int QInfo_peek_array_d(QInfo info, QInfo_index index, const double **vals,
+                       size_t *count);
+
+/**
+ * @brief Replaces the integer array stored at the index @p index in @p info.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_INT32_ARRAY.
+ * @param[in] vals Elements to store. May be NULL if @p count is zero.
+ * @param[in] count Number of elements, at most UINT32_MAX.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_array_i32(QInfo info, QInfo_index index, const int32_t *vals,
+                        size_t count);
+
+/**
+ * @brief Replaces the long array stored at the index @p index in @p info.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_INT64_ARRAY.
+ * @param[in] vals Elements to store. May be NULL if @p count is zero.
+ * @param[in] count Number of elements, at most UINT32_MAX.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_array_i64(QInfo info, QInfo_index index, const int64_t *vals,
+                        size_t count);
+
+/**
+ * @brief Replaces the float array stored at the index @p index in @p info.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_FLOAT_ARRAY.
+ * @param[in] vals Elements to store. May be NULL if @p count is zero.
+ * @param[in] count Number of elements, at most UINT32_MAX.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_array_f(QInfo info, QInfo_index index, const float *vals,
+                      size_t count);
+
+/**
+ * @brief Replaces the double array stored at the index @p index in @p info.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_DOUBLE_ARRAY.
+ * @param[in] vals Elements to store. May be NULL if @p count is zero.
+ * @param[in] count Number of elements, at most UINT32_MAX.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_array_d(QInfo info, QInfo_index index, const double *vals,
+                      size_t count);
+
+/**
+ * @brief Gets a borrowed pointer to the blob stored at the index @p index in
+ * @p info.
+ * @details Blobs hold arbitrary bytes of explicit length, which may include
+ * zero bytes. They are stored aligned to 64 bytes, so payloads of packed
+ * structures or numbers can be accessed in place.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_BLOB.
+ * @param[out] data Bytes of the blob, or NULL if it is empty.
+ * @param[out] size Number of bytes.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until the next call that modifies @p info,
+ * like the pointers returned by QInfo_peek_val_c.
+ */
+int QInfo_peek_blob(QInfo info, QInfo_index index, const void **data,
+                    size_t *size);
+
+/**
+ * @brief Replaces the blob stored at the index @p index in @p info.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_BLOB.
+ * @param[in] data Bytes to store. May be NULL if @p size is zero.
+ * @param[in] size Number of bytes, at most UINT32_MAX.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_blob(QInfo info, QInfo_index index, const void *data,
+                   size_t size);
+
+/**
+ * @brief Gets the QInfo object nested at the index @p index in @p info.
+ * @details The nested object is owned by @p info. It may be queried and
+ * modified through the returned handle, but must not be freed by the user.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_QINFO.
+ * @param[out] child Nested object (borrowed handle), or NULL if none is set.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The handle remains valid until the entry is set again or removed, or
+ * @p info is cleared or freed.
+ */
+int QInfo_peek_child(QInfo info, QInfo_index index, QInfo *child);
+
+/**
+ * @brief Nests @p child at the index @p index in @p info.
+ * @details On success, @p info takes ownership of @p child: the previously
+ * nested object, if any, is freed, and @p child is freed together with
+ * @p info. Duplicates and merges of @p info receive duplicates of @p child.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] index Index of an entry of type QINFO_TYPE_QINFO.
+ * @param[in] child Object to nest, or NULL to free the nested object.
+ * @return QINFO_SUCCESS on success, an error code otherwise. In particular,
+ * QINFO_ERROR_INVALIDTYPE if @p child is already nested in an object, is
+ * layered, or is @p info itself or an object that @p info is nested in.
+ */
+int QInfo_set_child(QInfo info, QInfo_index index, QInfo child);
+
+/**
+ * @brief Adds @p count new entries to @p info.
+ * @details Behaves like calling QInfo_add for each key, but grows the storage
+ * of @p info at most once. Either all or none of the entries are added.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] count Number of entries to add.
+ * @param[in] keys Keys (null-terminated strings) of the new entries.
+ * @param[in] types Types of the values to be stored.
+ * @param[out] indices Indices of the new entries.
+ * @return QINFO_SUCCESS on success, an error code otherwise. In particular,
+ * QINFO_ERROR_KEYEXISTS if any key already exists in @p info or occurs more
+ * than once in @p keys.
+ */
+int QInfo_add_many(QInfo info, size_t count, const char *const *keys,
+                   const enum QINFO_TYPE *types, QInfo_index *indices);
+
+/**
+ * @brief Queries the indices of the entries with the keys @p keys in @p info.
+ * @details For keys that do not exist in @p info, the corresponding index is
+ * set to -1, which is rejected by all functions taking an index.
+ * @param[in] info QInfo object (handle).
+ * @param[in] count Number of keys to query.
+ * @param[in] keys Keys (null-terminated strings).
+ * @param[out] indices Indices of the entries with the keys @p keys.
+ * @return QINFO_SUCCESS if all keys were found, QINFO_WARN_NOKEY if at least
+ * one key was not found.
+ */
+int QInfo_query_many(QInfo info, size_t count, const char *const *keys,
+                     QInfo_index *indices);
+
+/**
+ * @brief Gets the integer values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is read. If any index is
+ * invalid or refers to a value of another type, @p vals is left unchanged.
+ * @param[in] info QInfo object (handle).
+ * @param[in] count Number of values to get.
+ * @param[in] indices Indices of the entries.
+ * @param[out] vals Values stored at the indices @p indices.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_get_many_i32(QInfo info, size_t count, const QInfo_index *indices,
+                       int32_t *vals);
+
+/**
+ * @brief Gets the long values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is read. If any index is
+ * invalid or refers to a value of another type, @p vals is left unchanged.
+ * @param[in] info QInfo object (handle).
+ * @param[in] count Number of values to get.
+ * @param[in] indices Indices of the entries.
+ * @param[out] vals Values stored at the indices @p indices.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_get_many_i64(QInfo info, size_t count, const QInfo_index *indices,
+                       int64_t *vals);
+
+/**
+ * @brief Gets the float values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is read. If any index is
+ * invalid or refers to a value of another type, @p vals is left unchanged.
+ * @param[in] info QInfo object (handle).
+ * @param[in] count Number of values to get.
+ * @param[in] indices Indices of the entries.
+ * @param[out] vals Values stored at the indices @p indices.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_get_many_f(QInfo info, size_t count, const QInfo_index *indices,
+                     float *vals);
+
+/**
+ * @brief Gets the double values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is read. If any index is
+ * invalid or refers to a value of another type, @p vals is left unchanged.
+ * @param[in] info QInfo object (handle).
+ * @param[in] count Number of values to get.
+ * @param[in] indices Indices of the entries.
+ * @param[out] vals Values stored at the indices @p indices.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_get_many_d(QInfo info, size_t count, const QInfo_index *indices,
+                     double *vals);
+
+/**
+ * @brief Gets borrowed pointers to the string values stored at the indices
+ * @p indices in @p info.
+ * @details All indices are validated before any value is read. If any index is
+ * invalid or refers to a value of another type, @p vals is left unchanged.
+ * @param[in] info QInfo object (handle).
+ * @param[in] count Number of values to get.
+ * @param[in] indices Indices of the entries.
+ * @param[out] vals Null-terminated values stored at the indices @p indices.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointers are subject to the same lifetime rules as those returned
+ * by QInfo_peek_val_c.
+ */
+int QInfo_peek_many_c(QInfo info, size_t count, const QInfo_index *indices,
+                      const char **vals);
+
+/**
+ * @brief Sets the integer values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is written. If any
+ * index is invalid or refers to a value of another type, no value is set.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] count Number of values to set.
+ * @param[in] indices Indices of the entries.
+ * @param[in] vals Values to set.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_many_i32(QInfo info, size_t count, const QInfo_index *indices,
+                       const int32_t *vals);
+
+/**
+ * @brief Sets the long values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is written. If any
+ * index is invalid or refers to a value of another type, no value is set.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] count Number of values to set.
+ * @param[in] indices Indices of the entries.
+ * @param[in] vals Values to set.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_many_i64(QInfo info, size_t count, const QInfo_index *indices,
+                       const int64_t *vals);
+
+/**
+ * @brief Sets the float values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is written. If any
+ * index is invalid or refers to a value of another type, no value is set.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] count Number of values to set.
+ * @param[in] indices Indices of the entries.
+ * @param[in] vals Values to set.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_many_f(QInfo info, size_t count, const QInfo_index *indices,
+                     const float *vals);
+
+/**
+ * @brief Sets the double values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is written. If any
+ * index is invalid or refers to a value of another type, no value is set.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] count Number of values to set.
+ * @param[in] indices Indices of the entries.
+ * @param[in] vals Values to set.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_set_many_d(QInfo info, size_t count, const QInfo_index *indices,
+                     const double *vals);
+
+/**
+ * @brief Sets the string values stored at the indices @p indices in @p info.
+ * @details All indices are validated before any value is written. If any
+ * index is invalid or refers to a value of another type, no value is set.
+ * @param[in,out] info QInfo object (handle).
+ * @param[in] count Number of values to set.
+ * @param[in] indices Indices of the entries.
+ * @param[in] vals Values (null-terminated strings) to set.
+ * @return QINFO_SUCCESS on success, an error code otherwise. If
+ * QINFO_ERROR_OUTOFMEM is returned, a prefix of the values may have been set.
+ */
+int QInfo_set_many_c(QInfo info, size_t count, const QInfo_index *indices,
+                     const char *const *vals);
+
+/**
+ * @brief Atomically loads the integer value stored at the index @p index.
+ * @details The atomic functions let several threads update numeric values,
+ * such as counters, without a lock of their own. On objects created with
+ * QInfo_create_concurrent they run in parallel with each other and with all
+ * other reads and only wait for calls that modify the object. On other
+ * objects the usual rules apply: no other call may run concurrently.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note A value that other threads update atomically must only be read with
+ * the atomic load functions, not with QInfo_get_val_i32 and friends.
+ */
+int QInfo_load_i32(QInfo info, QInfo_index index, int32_t *val);
+
+/**
+ * @brief Atomically loads the long value stored at the index @p index.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_load_i64(QInfo info, QInfo_index index, int64_t *val);
+
+/**
+ * @brief Atomically loads the float value stored at the index @p index.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_load_f(QInfo info, QInfo_index index, float *val);
+
+/**
+ * @brief Atomically loads the double value stored at the index @p index.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_load_d(QInfo info, QInfo_index index, double *val);
+
+/**
+ * @brief Atomically stores the integer value @p val at the index @p index.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in] val Value to store.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_store_i32(QInfo info, QInfo_index index, int32_t val);
+
+/**
+ * @brief Atomically stores the long value @p val at the index @p index.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in] val Value to store.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_store_i64(QInfo info, QInfo_index index, int64_t val);
+
+/**
+ * @brief Atomically stores the float value @p val at the index @p index.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in] val Value to store.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_store_f(QInfo info, QInfo_index index, float val);
+
+/**
+ * @brief Atomically stores the double value @p val at the index @p index.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in] val Value to store.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_store_d(QInfo info, QInfo_index index, double val);
+
+/**
+ * @brief Atomically adds @p delta to the integer value stored at the index
+ * @p index.
+ * @details Overflow wraps around.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in] delta Value to add.
+ * @param[out] previous Value stored before the addition. May be NULL.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_fetch_add_i32(QInfo info, QInfo_index index, int32_t delta,
+                        int32_t *previous);
+
+/**
+ * @brief Atomically adds @p delta to the long value stored at the index
+ * @p index.
+ * @details Overflow wraps around.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in] delta Value to add.
+ * @param[out] previous Value stored before the addition. May be NULL.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_fetch_add_i64(QInfo info, QInfo_index index, int64_t delta,
+                        int64_t *previous);
+
+/**
+ * @brief Atomically replaces the integer value stored at the index @p index
+ * with @p desired if it equals @p expected.
+ * @details Values are compared by their object representation.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in,out] expected Value expected at the index @p index. Receives the
+ * actual value if the values differ.
+ * @param[in] desired Value to store.
+ * @return QINFO_SUCCESS if the value was replaced, QINFO_WARN_MISMATCH if the
+ * values differ, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_compare_exchange_i32(QInfo info, QInfo_index index,
+                               int32_t *expected, int32_t desired);
+
+/**
+ * @brief Atomically replaces the long value stored at the index @p index
+ * with @p desired if it equals @p expected.
+ * @details Values are compared by their object representation.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in,out] expected Value expected at the index @p index. Receives the
+ * actual value if the values differ.
+ * @param[in] desired Value to store.
+ * @return QINFO_SUCCESS if the value was replaced, QINFO_WARN_MISMATCH if the
+ * values differ, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_compare_exchange_i64(QInfo info, QInfo_index index,
+                               int64_t *expected, int64_t desired);
+
+/**
+ * @brief Atomically replaces the float value stored at the index @p index
+ * with @p desired if it equals @p expected.
+ * @details Values are compared by their object representation.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in,out] expected Value expected at the index @p index. Receives the
+ * actual value if the values differ.
+ * @param[in] desired Value to store.
+ * @return QINFO_SUCCESS if the value was replaced, QINFO_WARN_MISMATCH if the
+ * values differ, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_compare_exchange_f(QInfo info, QInfo_index index,
+                             float *expected, float desired);
+
+/**
+ * @brief Atomically replaces the double value stored at the index @p index
+ * with @p desired if it equals @p expected.
+ * @details Values are compared by their object representation.
+ * @param[in] info QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[in,out] expected Value expected at the index @p index. Receives the
+ * actual value if the values differ.
+ * @param[in] desired Value to store.
+ * @return QINFO_SUCCESS if the value was replaced, QINFO_WARN_MISMATCH if the
+ * values differ, an error code otherwise.
+ *
+ * @see QInfo_load_i32
+ */
+int QInfo_compare_exchange_d(QInfo info, QInfo_index index,
+                             double *expected, double desired);
+
 /**
  * @brief Gets an iterator to the first entry in @p info.
  * @param[in] info QInfo object (handle).
@@ -307,6 +1345,313 @@ void QInfo_next(QInfo info, QInfo_iterator *iter);
  */
 int QInfo_empty(QInfo info);
 
+/**
+ * @brief Adds all entries of @p src to @p dst.
+ * @details Keys present in both objects are resolved according to @p policy.
+ * With QINFO_MERGE_OVERWRITE, the entry of @p dst takes the type and value of
+ * the entry of @p src. Storage for all entries of @p src is reserved in
+ * @p dst upfront, and keys are looked up with the hashes cached in @p src.
+ * Keys and string values are not copied: @p dst shares them with @p src, in
+ * the same way as a duplicate does, so that merging takes time linear in the
+ * number of entries of @p src, independent of the length of its strings.
+ * @param[in,out] dst QInfo object (handle) to merge into.
+ * @param[in] src QInfo object (handle) to merge from. Its entries are not
+ * modified.
+ * @param[in] policy Policy for keys present in both objects.
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_KEYEXISTS if @p policy is
+ * QINFO_MERGE_ERROR and a key of @p src exists in @p dst, in which case
+ * @p dst is unchanged, an error code otherwise. If QINFO_ERROR_OUTOFMEM is
+ * returned, a part of the entries of @p src may have been merged.
+ * @note Indices of existing entries of @p dst remain valid. Both objects
+ * remain fully independent and may be freed in any order.
+ *
+ * @see QInfo_duplicate
+ */
+int QInfo_merge(QInfo dst, QInfo src, enum QINFO_MERGE_POLICY policy);
+
+/**
+ * @brief Serializes @p info into a contiguous buffer.
+ * @details The format is versioned and independent of the platform: integers
+ * are little-endian, floating-point values are stored as IEEE 754 bit
+ * patterns, and keys and string values are length-prefixed. Nested QInfo
+ * values are serialized recursively. Entries are written in iteration order.
+ * To query the required size, pass NULL as @p buffer.
+ * @param[in] info QInfo object (handle).
+ * @param[out] buffer Buffer to write to, or NULL.
+ * @param[in] capacity Size of @p buffer in bytes.
+ * @param[out] size Number of bytes written, or required if @p buffer is NULL
+ * or too small.
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_OUTOFBOUNDS if @p buffer is
+ * too small, an error code otherwise.
+ *
+ * @see QInfo_deserialize
+ */
+int QInfo_serialize(QInfo info, void *buffer, size_t capacity, size_t *size);
+
+/**
+ * @brief Creates a new QInfo object from a buffer written by
+ * QInfo_serialize.
+ * @details The input is validated completely before the object is built, so
+ * that all storage is allocated upfront. The entries of the new object have
+ * the same iteration order as the serialized object, but their indices may
+ * differ.
+ * @param[in] buffer Serialized QInfo object.
+ * @param[in] size Size of @p buffer in bytes.
+ * @param[out] info QInfo object created (handle).
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_INVALIDFORMAT if @p buffer is
+ * malformed, truncated, or of an unsupported version, an error code
+ * otherwise.
+ * @note The user is responsible for freeing the QInfo object using the
+ * QInfo_free function when the object is no longer needed.
+ *
+ * @see QInfo_serialize
+ */
+int QInfo_deserialize(const void *buffer, size_t size, QInfo *info);
+
+/**
+ * @brief Adds the entries of a text buffer to @p info.
+ * @details The text holds one entry per line:
+ * @code
+ * # comment
+ * shots:i32 = 1024
+ * calibration.timestamp:i64 = 1718000000
+ * qubit.0.fidelity:f32 = 0.9991     # trailing comment
+ * qubit.0.t1:f64 = 1.25e-4
+ * backend:str = "superconducting \"sc-20\""
+ * site:str = Garching
+ * notes:str
+ * @endcode
+ * Each entry consists of a key, a colon, a type (i32, i64, f32, f64, or str)
+ * and optionally an equals sign and a value. Entries without a value are 0,
+ * or an unset string. Keys are non-empty and contain no whitespace, ':', '=',
+ * '#', or '"'. Integers are decimal. Floating-point values use the syntax of
+ * strtod. String values are either enclosed in double quotes, where a
+ * backslash escapes a double quote, a backslash, or stands for a newline (n),
+ * carriage return (r), or tab (t), or extend unquoted to the end of the line
+ * or a '#', with surrounding whitespace trimmed. Empty lines and lines
+ * starting with '#' are ignored.
+ * The text is parsed in place and storage for all lines is reserved upfront.
+ * @param[in] info QInfo object (handle).
+ * @param[in] buffer Text to parse (not necessarily null-terminated).
+ * @param[in] size Size of @p buffer in bytes.
+ * @param[out] error_line Number of the line (starting at 1) at which loading
+ * failed. May be NULL.
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_INVALIDFORMAT if a line is
+ * malformed, QINFO_ERROR_KEYEXISTS if a key exists already, an error code
+ * otherwise. On failure, no entries are added.
+ * @note Floating-point values are parsed according to the current C locale,
+ * which should use '.' as the decimal point.
+ *
+ * @see QInfo_load_file
+ */
+int QInfo_load_buffer(QInfo info, const char *buffer, size_t size,
+                      size_t *error_line);
+
+/**
+ * @brief Adds the entries of a text file to @p info.
+ * @details The file is mapped into memory and parsed with QInfo_load_buffer.
+ * @param[in] info QInfo object (handle).
+ * @param[in] path Path of the text file.
+ * @param[out] error_line Number of the line (starting at 1) at which loading
+ * failed. May be NULL.
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_IO if the file cannot be
+ * read, an error code of QInfo_load_buffer otherwise.
+ *
+ * @see QInfo_load_buffer
+ */
+int QInfo_load_file(QInfo info, const char *path, size_t *error_line);
+
+/**
+ * @brief Compiles @p info into a frozen QInfo object.
+ * @details The frozen object holds a copy of all key-value pairs of @p info
+ * and is independent of @p info afterwards. Building the perfect hash takes
+ * expected linear time in the number of entries.
+ * @param[in] info QInfo object (handle) to freeze.
+ * @param[out] frozen Frozen QInfo object created (handle).
+ * @return QINFO_SUCCESS on success, an error code otherwise. In particular,
+ * QINFO_ERROR_OUTOFBOUNDS if the keys and string values of @p info exceed
+ * 4 GiB, QINFO_ERROR_INVALIDTYPE if @p info holds array, blob or nested
+ * values, and QINFO_ERROR_FATAL in the extremely unlikely case that two keys
+ * of @p info have the same 64-bit hash.
+ * @note The user is responsible for freeing the frozen object using the
+ * QInfo_frozen_free function when the object is no longer needed.
+ *
+ * @see QInfo_frozen_free
+ */
+int QInfo_freeze(QInfo info, QInfo_frozen *frozen);
+
+/**
+ * @brief Frees a frozen QInfo object.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_frozen_free(QInfo_frozen frozen);
+
+/**
+ * @brief Writes @p frozen to a snapshot file at @p path.
+ * @details A snapshot file holds the frozen object as it is laid out in
+ * memory, so that QInfo_open_mapped can use it without parsing it. Snapshot
+ * files can only be opened on machines with the same byte order.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] path Path of the file to write. An existing file is replaced.
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_IO if the file cannot be
+ * written.
+ * @note A snapshot file must not be overwritten while processes have it
+ * mapped. Write a new file and rename it over the old one instead.
+ *
+ * @see QInfo_open_mapped
+ */
+int QInfo_frozen_save(QInfo_frozen frozen, const char *path);
+
+/**
+ * @brief Opens a snapshot file written by QInfo_frozen_save as a frozen
+ * QInfo object.
+ * @details The file is mapped read-only into memory and queries are answered
+ * directly from the mapped pages. Opening takes constant time regardless of
+ * the number of entries, and the pages are shared between all processes that
+ * map the same file.
+ * @param[in] path Path of the snapshot file.
+ * @param[out] frozen Frozen QInfo object (handle) backed by the file.
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_IO if the file cannot be
+ * opened or mapped, QINFO_ERROR_INVALIDFORMAT if it is not a snapshot file of
+ * a supported version and byte order.
+ * @note Only the header of the file is validated. Snapshot files must come
+ * from a trusted source, just like shared libraries. Free the object with
+ * QInfo_frozen_free to unmap the file.
+ *
+ * @see QInfo_frozen_save
+ */
+int QInfo_open_mapped(const char *path, QInfo_frozen *frozen);
+
+/**
+ * @brief Gets the number of entries in @p frozen.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @return The number of entries. Valid indices are 0 to this number minus 1.
+ */
+int QInfo_frozen_size(QInfo_frozen frozen);
+
+/**
+ * @brief Queries the index of the entry with the key @p key in @p frozen.
+ * @details Performs no allocation and at most one key comparison.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] key Key (null-terminated string).
+ * @param[out] index Index of the entry with the key @p key.
+ * @return QINFO_SUCCESS on success, QINFO_WARN_NOKEY if no entry with the key
+ * @p key exists.
+ */
+int QInfo_frozen_query(QInfo_frozen frozen, const char *key,
+                       QInfo_index *index);
+
+/**
+ * @brief Queries the index of the entry with a key of explicit length in
+ * @p frozen.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] key Key (not necessarily null-terminated).
+ * @param[in] length Length of the key in bytes.
+ * @param[out] index Index of the entry with the key @p key.
+ * @return QINFO_SUCCESS on success, QINFO_WARN_NOKEY if no entry with the key
+ * @p key exists.
+ *
+ * @see QInfo_frozen_query
+ */
+int QInfo_frozen_query_n(QInfo_frozen frozen, const char *key, size_t length,
+                         QInfo_index *index);
+
+/**
+ * @brief Queries the index of the entry with a precomputed key in @p frozen.
+ * @details Key handles created with QInfo_key_make work with frozen and
+ * regular QInfo objects alike.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] key Key handle created with QInfo_key_make.
+ * @param[out] index Index of the entry with the key @p key.
+ * @return QINFO_SUCCESS on success, QINFO_WARN_NOKEY if no entry with the key
+ * @p key exists.
+ *
+ * @see QInfo_frozen_query
+ */
+int QInfo_frozen_query_key(QInfo_frozen frozen, const QInfo_key *key,
+                           QInfo_index *index);
+
+/**
+ * @brief Gets a borrowed pointer to the key stored at the index @p index in
+ * @p frozen.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] key Null-terminated key stored at the index @p index.
+ * @param[out] length Length of the key in bytes, excluding the terminator. May
+ * be NULL.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until @p frozen is freed.
+ */
+int QInfo_frozen_peek_key(QInfo_frozen frozen, QInfo_index index,
+                          const char **key, size_t *length);
+
+/**
+ * @brief Gets the type of the value stored at the index @p index in
+ * @p frozen.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] type Type of the value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_frozen_get_type(QInfo_frozen frozen, QInfo_index index,
+                          enum QINFO_TYPE *type);
+
+/**
+ * @brief Gets the integer value stored at the index @p index in @p frozen.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_frozen_get_val_i32(QInfo_frozen frozen, QInfo_index index,
+                             int32_t *val);
+
+/**
+ * @brief Gets the long value stored at the index @p index in @p frozen.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_frozen_get_val_i64(QInfo_frozen frozen, QInfo_index index,
+                             int64_t *val);
+
+/**
+ * @brief Gets the float value stored at the index @p index in @p frozen.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_frozen_get_val_f(QInfo_frozen frozen, QInfo_index index, float *val);
+
+/**
+ * @brief Gets the double value stored at the index @p index in @p frozen.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Value stored at the index @p index.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+int QInfo_frozen_get_val_d(QInfo_frozen frozen, QInfo_index index,
+                           double *val);
+
+/**
+ * @brief Gets a borrowed pointer to the string value stored at the index
+ * @p index in @p frozen.
+ * @details If no value had been set when @p frozen was created, @p val is set
+ * to NULL and @p length to 0.
+ * @param[in] frozen Frozen QInfo object (handle).
+ * @param[in] index Index of the entry.
+ * @param[out] val Null-terminated value stored at the index @p index.
+ * @param[out] length Length of the value in bytes, excluding the terminator.
+ * May be NULL.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ * @note The pointer remains valid until @p frozen is freed.
+ */
+int QInfo_frozen_peek_val_c(QInfo_frozen frozen, QInfo_index index,
+                            const char **val, size_t *length);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
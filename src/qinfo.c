@@ -11,14 +11,183 @@ SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
 #include "qinfo.h"
 
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Initial size of the value space of a QInfo object.
+ */
+const int QINFO_INTERNAL_INITIALSPACE = 16;
+
+/**
+ * @brief Factor by which the value space grows when it is full.
+ * @details Geometric growth keeps the amortized cost of QInfo_add constant;
+ * filling an object with n entries performs O(log n) reallocations.
+ */
+const int QINFO_INTERNAL_SPACEGROWTHFACTOR = 2;
+
+/**
+ * @brief Initial number of buckets in the hash index of a QInfo object.
+ * @details Must be a power of two.
+ */
+const int QINFO_INTERNAL_INDEXBUCKETS = 16;
+
+/**
+ * @brief Marker for an empty bucket in the hash index.
+ */
+const int32_t QINFO_INTERNAL_EMPTYBUCKET = -1;
+
+/**
+ * @brief Marker for the end of the free list of a QInfo object.
+ */
+const int QINFO_INTERNAL_NOSLOT = -1;
+
+/**
+ * @brief Number of slots tracked by one word of the occupancy bitmap.
+ */
+#define QINFO_INTERNAL_WORDBITS 64
+
+/**
+ * @brief Number of slots per page of the value space.
+ * @details Pages are the unit of copy-on-write sharing between duplicates. A
+ * page covers exactly one word of the occupancy bitmap.
+ */
+#define QINFO_INTERNAL_PAGESLOTS QINFO_INTERNAL_WORDBITS
+
+/**
+ * @brief Size in bytes of the inline storage of a string.
+ * @details Strings shorter than this are stored inside the slot itself and
+ * never touch the allocator.
+ */
+#define QINFO_INTERNAL_INLINESTRING 16
+
+/**
+ * @brief Tag marking a string that is not stored inline.
+ */
+#define QINFO_INTERNAL_HEAPSTRING 0xFFU
+
+/**
+ * @brief Granularity in bytes of blocks handed out by the string arena.
+ */
+#define QINFO_INTERNAL_ARENAGRANULE 8
+
+/**
+ * @brief Number of block sizes for which the string arena keeps free lists.
+ * @details Released blocks of up to QINFO_INTERNAL_ARENAFREECLASSES granules
+ * are reused by later allocations of the same size. Larger blocks are only
+ * reclaimed by QInfo_compact.
+ */
+#define QINFO_INTERNAL_ARENAFREECLASSES 16
+
+/**
+ * @brief Alignment in bytes of the elements of array values.
+ * @details A cache line, which also suits the widest vector instructions.
+ */
+#define QINFO_INTERNAL_ARRAYALIGN 64
+
+/**
+ * @brief Size in bytes of the first chunk of a string arena.
+ */
+const size_t QINFO_INTERNAL_ARENACHUNK = 1024;
+
+/**
+ * @brief Upper bound in bytes for the geometric growth of arena chunks.
+ */
+const size_t QINFO_INTERNAL_ARENAMAXCHUNK = (size_t)1 << 20U;
+
+/**
+ * @brief Maximum number of objects in the recycling pool of a thread.
+ */
+#define QINFO_INTERNAL_POOLSIZE 8
+
+/**
+ * @brief Number of reader counters of a concurrent QInfo object.
+ * @details Each thread registers its reads with one of the counters, so that
+ * readers on different cores rarely write to the same cache line.
+ */
+#define QINFO_INTERNAL_READERSHARDS 32
+
+/**
+ * @brief Size in bytes of a reader counter including its padding.
+ * @details Twice the common cache line size, so that no two counters share a
+ * cache line or an adjacent-line prefetch pair regardless of alignment.
+ */
+#define QINFO_INTERNAL_SHARDSIZE 128
+
+/**
+ * @brief Number of low bits of an index of a layered QInfo object that hold
+ * the slot, the remaining bits hold the layer.
+ * @details An index of a layered object refers to the object itself for layer
+ * 0, to its parent for layer 1, and so on.
+ */
+#define QINFO_INTERNAL_LAYERSHIFT 24U
+
+/**
+ * @brief Maximum number of slots of a layered QInfo object.
+ */
+#define QINFO_INTERNAL_LAYERSLOTS (1 << QINFO_INTERNAL_LAYERSHIFT)
+
+/**
+ * @brief Maximum number of ancestors of a layered QInfo object.
+ */
+#define QINFO_INTERNAL_MAXLAYERS 127
+
+/**
+ * @brief Number of busy-wait iterations before a waiting thread yields.
+ */
+const int QINFO_INTERNAL_SPINLIMIT = 64;
+
+/**
+ * @brief Internal representation of a string with small-string optimization.
+ * @details Strings of fewer than QINFO_INTERNAL_INLINESTRING characters are
+ * stored in @p buffer. The last byte of @p buffer then holds the number of
+ * unused characters, which doubles as the terminator of a string of maximal
+ * inline length. Longer strings live in the arena of the QInfo object and the
+ * last byte holds QINFO_INTERNAL_HEAPSTRING.
+ */
+typedef union QInfo_string_d {
+  struct {
+    char *data;      /**< The string in the arena, or NULL if unset. */
+    uint32_t length; /**< The length of the string. */
+    char reserved[QINFO_INTERNAL_INLINESTRING - sizeof(char *) -
+                  sizeof(uint32_t) - 1]; /**< Unused. */
+    unsigned char tag;                   /**< The last byte of @p buffer. */
+  } heap;
+  char buffer[QINFO_INTERNAL_INLINESTRING]; /**< The inline string. */
+} QInfo_string;
+
+_Static_assert(sizeof(((QInfo_string *)NULL)->heap) ==
+                   QINFO_INTERNAL_INLINESTRING,
+               "The tag of a heap string must overlay the last inline byte");
+
 /**
- * @brief Internal granularity for space allocation within the QInfo object.
+ * @brief Internal representation of an array value.
+ * @details The elements live in the arena of the QInfo object, aligned to
+ * QINFO_INTERNAL_ARRAYALIGN bytes.
  */
-const int QINFO_INTERNAL_SPACEGRANULARITY = 10;
+typedef struct QInfo_array_d {
+  void *data;     /**< The elements in the arena, or NULL if empty. */
+  uint32_t count; /**< The number of elements. */
+} QInfo_array;
 
 /**
  * @brief QInfo value union.
@@ -29,403 +198,5574 @@ typedef union QInfo_value_d {
   int64_t value_i64;
   float value_float;
   double value_double;
-  char *value_string;
+  QInfo_string value_string;
+  QInfo_array value_array;
+  QInfo value_qinfo;
 } QInfo_value;
 
 /**
  * @brief Internal structure for representing key value pairs in a QInfo object.
  */
 typedef struct QInfo_value_space_d {
-  QInfo_value value;    /**< The value of the key. */
-  int occupied;         /**< Flag indicating if the key is occupied. */
+  QInfo_value value;    /**< The value of the key, or the next free slot. */
+  QInfo_string name;    /**< The name of the key. */
+  uint64_t hash;        /**< The cached hash of the key. */
   enum QINFO_TYPE type; /**< The type of the value. */
-  char *name;           /**< The name of the key. */
 } QInfo_value_space_t;
 
 /**
- * @brief Internal structure for representing a QInfo object.
+ * @brief Internal structure for a page of the value space.
+ * @details Pages may be shared between a QInfo object and its duplicates. A
+ * shared page is copied by the first object that modifies one of its slots.
+ * All pages hold QINFO_INTERNAL_PAGESLOTS slots, except for the last page of
+ * a value space whose size is not a multiple of it.
+ */
+typedef struct QInfo_page_d {
+  atomic_int refcount; /**< The number of page tables referencing the page. */
+  QInfo_value_space_t slots[]; /**< The slots of the page. */
+} QInfo_page_t;
+
+/**
+ * @brief Internal structure for the page table of a value space.
+ * @details The page table is shared between a QInfo object and its duplicates
+ * until one of them modifies a slot.
+ */
+typedef struct QInfo_page_table_d {
+  atomic_int refcount;   /**< The number of objects referencing the table. */
+  int num_pages;         /**< The number of allocated pages. */
+  QInfo_page_t *pages[]; /**< The pages of the value space. */
+} QInfo_page_table_t;
+
+/**
+ * @brief Internal structure for a bucket of the hash index.
+ * @details The hash index maps keys to slots of the value space using open
+ * addressing with linear probing. Each bucket caches the upper half of the key
+ * hash so that most mismatches are rejected without touching the value space.
+ */
+typedef struct QInfo_hash_bucket_d {
+  uint32_t tag;  /**< The upper 32 bits of the key hash. */
+  int32_t index; /**< The slot of the key or QINFO_INTERNAL_EMPTYBUCKET. */
+} QInfo_hash_bucket_t;
+
+/**
+ * @brief Internal structure for the hash index and the occupancy bitmap.
+ * @details Both only change when entries are added or removed, so they are
+ * shared between a QInfo object and its duplicates until then.
+ */
+typedef struct QInfo_index_d {
+  atomic_int refcount;          /**< The number of objects referencing it. */
+  uint32_t num_buckets;         /**< The number of hash buckets. */
+  QInfo_hash_bucket_t *buckets; /**< The hash index over the keys. */
+  uint64_t *occupied;           /**< Bitmap of the occupied slots. */
+} QInfo_index_t;
+
+/**
+ * @brief Internal structure for a chunk of a string arena.
+ */
+typedef struct QInfo_arena_chunk_d {
+  struct QInfo_arena_chunk_d *next; /**< The previously filled chunk. */
+  size_t size;                      /**< The capacity of the chunk. */
+  size_t used;                      /**< The number of bytes handed out. */
+  char data[];                      /**< The storage of the chunk. */
+} QInfo_arena_chunk_t;
+
+/**
+ * @brief Internal structure for arena chunks shared between duplicates.
+ * @details When a QInfo object is duplicated, the chunks of its arena are
+ * frozen into a segment that both objects reference. Strings in a segment are
+ * never modified or reused, and the segment is freed together with the last
+ * object referencing it. QInfo_merge links the segments of the source object
+ * into the destination through a segment without chunks of its own.
+ */
+typedef struct QInfo_arena_segment_d {
+  atomic_int refcount; /**< The number of objects referencing the segment. */
+  struct QInfo_arena_segment_d *next; /**< The previously frozen segment. */
+  struct QInfo_arena_segment_d *merged; /**< Segments of a merged object. */
+  QInfo_arena_chunk_t *chunks;          /**< The frozen chunks. */
+  QInfo_allocator allocator; /**< The allocator of the segment and chunks. */
+} QInfo_arena_segment_t;
+
+#ifdef QINFO_ENABLE_STATS
+/**
+ * @brief Internal structure for the operation counters of a QInfo object.
+ * @details Lookups may run in parallel on a concurrent object, so their
+ * counters are updated atomically. All other counters only change while the
+ * object is locked for writing.
+ */
+typedef struct QInfo_counters_d {
+  atomic_ullong lookups;   /**< The number of lookups in the hash index. */
+  atomic_ullong hits;      /**< The number of lookups that found the key. */
+  atomic_ullong probes;    /**< The number of buckets inspected by lookups. */
+  atomic_ullong max_probe; /**< The longest probe sequence of a lookup. */
+  uint64_t growths;        /**< The number of times the storage grew. */
+  uint64_t allocations;    /**< The number of allocations. */
+  size_t base_bytes; /**< The footprint without own chunks when last sampled. */
+  size_t peak_bytes; /**< The largest footprint sampled. */
+} QInfo_counters_t;
+#endif
+
+/**
+ * @brief Internal structure for the string arena of a QInfo object.
+ * @details Keys and string values are carved out of large chunks by bumping a
+ * pointer, so that a QInfo object with thousands of entries needs only a
+ * handful of allocations for all of its strings. Strings never move, except
+ * when the arena is compacted. The arena also holds the allocator that the
+ * object uses for its value space and hash index, and the operation counters
+ * of the object if QInfo is built with QINFO_ENABLE_STATS.
+ */
+typedef struct QInfo_arena_d {
+  QInfo_arena_chunk_t *chunks; /**< The chunk currently bumped from. */
+  char *free[QINFO_INTERNAL_ARENAFREECLASSES]; /**< Released small blocks. */
+  size_t live;   /**< The number of bytes in blocks holding live strings. */
+  size_t wasted; /**< The number of bytes in blocks that were released. */
+  QInfo_arena_segment_t *shared; /**< Chunks shared with duplicates. */
+  QInfo_allocator allocator; /**< The allocator for all storage. */
+#ifdef QINFO_ENABLE_STATS
+  QInfo_counters_t counters; /**< The operation counters of the object. */
+#endif
+} QInfo_arena_t;
+
+/**
+ * @brief Internal structure for a reader counter of a concurrent QInfo object.
+ */
+typedef struct QInfo_reader_shard_d {
+  atomic_int readers; /**< The number of readers inside the object. */
+  char padding[QINFO_INTERNAL_SHARDSIZE - sizeof(atomic_int)]; /**< Unused. */
+} QInfo_reader_shard_t;
+
+/**
+ * @brief Internal structure for the reader-writer lock of a concurrent QInfo
+ * object.
+ * @details Readers only increment the counter of their own shard and check
+ * the writer flag, so parallel readers do not contend. A writer raises the
+ * flag and waits until all counters drained, which makes writes expensive
+ * but keeps reads cheap.
+ */
+typedef struct QInfo_sync_d {
+  atomic_int writer; /**< Whether a writer holds or awaits the lock. */
+  char padding[QINFO_INTERNAL_SHARDSIZE - sizeof(atomic_int)]; /**< Unused. */
+  QInfo_reader_shard_t shards[QINFO_INTERNAL_READERSHARDS]; /**< Readers. */
+} QInfo_sync_t;
 
+/**
+ * @brief Internal structure for representing a QInfo object.
  */
 typedef struct QInfo_impl_d {
-  int size;                         /**< The size of the value space. */
-  int num_occupied;                 /**< The number of occupied keys. */
-  QInfo_value_space_t *value_space; /**< The list of key-value pairs. */
+  int size;                  /**< The size of the value space. */
+  int num_occupied;          /**< The number of occupied keys. */
+  int num_used;              /**< The number of slots handed out. */
+  int free_head;             /**< The most recently vacated slot. */
+  QInfo_page_table_t *table; /**< The pages holding the key-value pairs. */
+  QInfo_index_t *index;      /**< The hash index and occupancy bitmap. */
+  QInfo_arena_t arena;       /**< The storage for all strings. */
+  QInfo_sync_t *sync; /**< The reader-writer lock, or NULL if not shared. */
+  struct QInfo_impl_d *parent; /**< The fallback for missing keys, or NULL. */
+  int depth;                   /**< The number of ancestors. */
+  atomic_ullong *profile; /**< Lookups per slot, or NULL if not profiled. */
+  struct QInfo_impl_d *owner; /**< The object nesting this one, or NULL. */
+  int num_children;           /**< The number of nested objects. */
 } QInfo_impl_t;
 
-int QInfo_create(QInfo *info) {
-  *info = (QInfo_impl_t *)malloc(sizeof(QInfo_impl_t));
-  if (*info == NULL) {
-    return QINFO_ERROR_OUTOFMEM;
+/**
+ * @brief Average number of keys per bucket of the perfect hash of a frozen
+ * QInfo object.
+ */
+const uint32_t QINFO_INTERNAL_FROZENBUCKETSIZE = 4;
+
+/**
+ * @brief Multiplier spreading the pilot of a bucket over all bits of the key
+ * hash (2^64 divided by the golden ratio).
+ */
+const uint64_t QINFO_INTERNAL_PILOTMULT = 0x9e3779b97f4a7c15ULL;
+
+/**
+ * @brief Marker for an unset string value in a frozen QInfo object.
+ */
+const uint32_t QINFO_INTERNAL_FROZENUNSET = UINT32_MAX;
+
+/**
+ * @brief Flag of a frozen QInfo object that lives in a mapped snapshot file.
+ */
+const uint32_t QINFO_INTERNAL_FROZENMAPPED = 1U;
+
+/**
+ * @brief Magic string at the start of a snapshot file.
+ */
+const char QINFO_INTERNAL_SNAPSHOTMAGIC[8] = {'Q', 'I', 'N', 'F',
+                                              'O', 'S', 'N', 'P'};
+
+/**
+ * @brief Version of the snapshot file format.
+ */
+const uint32_t QINFO_INTERNAL_SNAPSHOTVERSION = 1;
+
+/**
+ * @brief Marker revealing the byte order of the machine that wrote a
+ * snapshot file.
+ */
+const uint32_t QINFO_INTERNAL_BYTEORDER = 0x01020304U;
+
+/**
+ * @brief Magic number at the start of a serialized QInfo object ("QINF").
+ */
+const uint32_t QINFO_INTERNAL_SERIALMAGIC = 0x464e4951U;
+
+/**
+ * @brief Version of the serialization format written by QInfo_serialize.
+ */
+const uint32_t QINFO_INTERNAL_SERIALVERSION = 1;
+
+/**
+ * @brief Size in bytes of the header of a serialized QInfo object.
+ * @details The header holds the magic number, the format version (16 bits),
+ * reserved flags (16 bits) and the number of entries (32 bits).
+ */
+const size_t QINFO_INTERNAL_SERIALHEADER = 12;
+
+/**
+ * @brief Length marking an unset string value in a serialized QInfo object.
+ */
+const uint32_t QINFO_INTERNAL_SERIALUNSET = UINT32_MAX;
+
+/**
+ * @brief Number of entries QInfo_deserialize and QInfo_load_buffer hash ahead
+ * of inserting them.
+ */
+#define QINFO_INTERNAL_SERIALBATCH 16U
+
+/**
+ * @brief Maximum nesting depth of QInfo values in a serialized QInfo object.
+ */
+#define QINFO_INTERNAL_MAXNESTING 64
+
+/**
+ * @brief Internal structure for an entry of a frozen QInfo object.
+ * @details Keys and string values are referenced by their offset into the
+ * string area, so that the whole object is position-independent.
+ */
+typedef struct QInfo_frozen_entry_d {
+  uint64_t hash;       /**< The hash of the key. */
+  uint32_t key_offset; /**< The offset of the key in the string area. */
+  uint32_t key_length; /**< The length of the key. */
+  union {
+    int32_t value_i32;
+    int64_t value_i64;
+    float value_float;
+    double value_double;
+    struct {
+      uint32_t offset; /**< The offset or QINFO_INTERNAL_FROZENUNSET. */
+      uint32_t length; /**< The length of the string. */
+    } value_string;
+  } value;           /**< The value of the entry. */
+  uint32_t type;     /**< The type of the value. */
+  uint32_t reserved; /**< Unused. */
+} QInfo_frozen_entry_t;
+
+/**
+ * @brief Internal structure for representing a frozen QInfo object.
+ * @details A frozen object is a single allocation. The header is followed by
+ * the pilots of the perfect hash (one per bucket), the remap table for hash
+ * positions beyond the number of entries, the entries themselves, and the
+ * string area holding all null-terminated keys and string values.
+ */
+typedef struct QInfo_frozen_impl_d {
+  uint32_t num_entries;   /**< The number of entries. */
+  uint32_t num_buckets;   /**< The number of buckets of the perfect hash. */
+  uint32_t num_positions; /**< The range of the perfect hash before remap. */
+  uint32_t flags;         /**< QINFO_INTERNAL_FROZENMAPPED or 0. */
+  uint64_t entries_offset; /**< The offset of the entries in bytes. */
+  uint64_t strings_offset; /**< The offset of the string area in bytes. */
+  uint64_t size;           /**< The total size in bytes. */
+} QInfo_frozen_impl_t;
+
+_Static_assert(sizeof(QInfo_frozen_entry_t) == 32 &&
+                   sizeof(QInfo_frozen_impl_t) == 40,
+               "The layout of frozen objects is part of the snapshot format");
+
+/**
+ * @brief Internal structure for the header of a snapshot file.
+ * @details A snapshot file consists of this header followed by the image of a
+ * frozen QInfo object, which is used in place once the file is mapped. The
+ * image is stored in the byte order of the machine that wrote it.
+ */
+typedef struct QInfo_snapshot_header_d {
+  char magic[8];       /**< QINFO_INTERNAL_SNAPSHOTMAGIC. */
+  uint32_t version;    /**< QINFO_INTERNAL_SNAPSHOTVERSION. */
+  uint32_t byte_order; /**< QINFO_INTERNAL_BYTEORDER as written. */
+} QInfo_snapshot_header_t;
+
+static inline int Count_trailing_zeros(const uint64_t word) {
+#if defined(_MSC_VER)
+  unsigned long pos = 0;
+  _BitScanForward64(&pos, word);
+  return (int)pos;
+#else
+  return __builtin_ctzll(word);
+#endif
+}
+
+static inline int Bitmap_words(const int size) {
+  return (size + QINFO_INTERNAL_WORDBITS - 1) / QINFO_INTERNAL_WORDBITS;
+}
+
+static inline int Is_occupied(QInfo info, const int slot) {
+  return (int)((info->index->occupied[slot / QINFO_INTERNAL_WORDBITS] >>
+                (unsigned)(slot % QINFO_INTERNAL_WORDBITS)) &
+               1U);
+}
+
+static inline void Set_occupied(QInfo info, const int slot) {
+  info->index->occupied[slot / QINFO_INTERNAL_WORDBITS] |=
+      1ULL << (unsigned)(slot % QINFO_INTERNAL_WORDBITS);
+}
+
+static inline void Clear_occupied(QInfo info, const int slot) {
+  info->index->occupied[slot / QINFO_INTERNAL_WORDBITS] &=
+      ~(1ULL << (unsigned)(slot % QINFO_INTERNAL_WORDBITS));
+}
+
+static inline int Is_shared(atomic_int *refcount) {
+  return atomic_load_explicit(refcount, memory_order_acquire) > 1;
+}
+
+static inline void Ref_acquire(atomic_int *refcount) {
+  atomic_fetch_add_explicit(refcount, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Drops a reference.
+ * @return 1 if this was the last reference, 0 otherwise.
+ */
+static inline int Ref_release(atomic_int *refcount) {
+  return atomic_fetch_sub_explicit(refcount, 1, memory_order_acq_rel) == 1;
+}
+
+/**
+ * @brief The reader shard of the calling thread, or -1 if not yet assigned.
+ */
+static _Thread_local int Thread_reader_shard = -1;
+
+/**
+ * @brief The number of reader shards handed out so far.
+ */
+static atomic_uint Reader_shards_assigned;
+
+static inline int Reader_shard(void) {
+  if (Thread_reader_shard < 0) {
+    // Spread threads round-robin over the shards.
+    Thread_reader_shard =
+        (int)(atomic_fetch_add_explicit(&Reader_shards_assigned, 1U,
+                                        memory_order_relaxed) %
+              QINFO_INTERNAL_READERSHARDS);
   }
+  return Thread_reader_shard;
+}
 
-  (*info)->size = QINFO_INTERNAL_SPACEGRANULARITY;
-  (*info)->num_occupied = 0;
+/**
+ * @brief Waits a little before the caller retries to take a lock.
+ * @details Spins for the first QINFO_INTERNAL_SPINLIMIT calls and yields the
+ * processor afterwards.
+ */
+static void Spin_wait(int *spins) {
+  if (*spins < QINFO_INTERNAL_SPINLIMIT) {
+    ++*spins;
+#if defined(_WIN32)
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+    return;
+  }
+#if defined(_WIN32)
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
 
-  (*info)->value_space = (QInfo_value_space_t *)malloc(
-      sizeof(QInfo_value_space_t) * (unsigned long)(*info)->size);
-  if ((*info)->value_space == NULL) {
-    free(*info);
-    return QINFO_ERROR_OUTOFMEM;
+/**
+ * @brief Enters a read section on @p info.
+ * @details Does nothing unless @p info was created with
+ * QInfo_create_concurrent. Read sections do not nest.
+ */
+static void Read_lock(QInfo info) {
+  if (info->sync == NULL) {
+    return;
+  }
+  atomic_int *readers = &info->sync->shards[Reader_shard()].readers;
+  int spins = 0;
+  for (;;) {
+    // Sequentially consistent, so that either this reader sees the flag of a
+    // writer or the writer sees the reader.
+    atomic_fetch_add(readers, 1);
+    if (atomic_load(&info->sync->writer) == 0) {
+      return;
+    }
+    // Step back so that the writer can proceed, then retry.
+    atomic_fetch_sub_explicit(readers, 1, memory_order_release);
+    while (atomic_load_explicit(&info->sync->writer, memory_order_relaxed)) {
+      Spin_wait(&spins);
+    }
   }
+}
 
-  for (int i = 0; i < (*info)->size; ++i) {
-    (*info)->value_space[i].occupied = 0;
-    (*info)->value_space[i].name = NULL;
-    (*info)->value_space[i].type = QINFO_TYPE_INT32;
-    (*info)->value_space[i].value.value_i32 = 0;
+static void Read_unlock(QInfo info) {
+  if (info->sync != NULL) {
+    atomic_fetch_sub_explicit(&info->sync->shards[Reader_shard()].readers, 1,
+                              memory_order_release);
   }
+}
 
-  return QINFO_SUCCESS;
+/**
+ * @brief Enters a write section on @p info, excluding all readers and other
+ * writers.
+ * @details Does nothing unless @p info was created with
+ * QInfo_create_concurrent.
+ */
+static void Write_lock(QInfo info) {
+  if (info->sync == NULL) {
+    return;
+  }
+  int spins = 0;
+  while (atomic_exchange(&info->sync->writer, 1) != 0) {
+    Spin_wait(&spins);
+  }
+  for (int i = 0; i < QINFO_INTERNAL_READERSHARDS; ++i) {
+    while (atomic_load(&info->sync->shards[i].readers) != 0) {
+      Spin_wait(&spins);
+    }
+  }
 }
 
-int QInfo_duplicate(QInfo info_in, QInfo *info_out) {
-  *info_out = (QInfo_impl_t *)malloc(sizeof(QInfo_impl_t));
-  if (*info_out == NULL) {
+static void Write_unlock(QInfo info) {
+  if (info->sync != NULL) {
+    atomic_store_explicit(&info->sync->writer, 0, memory_order_release);
+  }
+}
+
+#ifdef QINFO_ENABLE_STATS
+static inline void Stats_init(QInfo_arena_t *arena) {
+  QInfo_counters_t *counters = &arena->counters;
+  atomic_init(&counters->lookups, 0);
+  atomic_init(&counters->hits, 0);
+  atomic_init(&counters->probes, 0);
+  atomic_init(&counters->max_probe, 0);
+  counters->growths = 0;
+  counters->allocations = 0;
+  counters->base_bytes = 0;
+  counters->peak_bytes = 0;
+}
+
+static inline void Stats_allocation(QInfo_arena_t *arena) {
+  arena->counters.allocations++;
+}
+#else
+static inline void Stats_init(QInfo_arena_t *arena) { (void)arena; }
+
+static inline void Stats_allocation(QInfo_arena_t *arena) { (void)arena; }
+#endif
+
+/**
+ * @brief Allocates @p size bytes with the allocator of @p arena, or with
+ * malloc if the object has no allocator.
+ */
+static void *Mem_alloc(QInfo_arena_t *arena, const size_t size) {
+  const QInfo_allocator *allocator = &arena->allocator;
+  Stats_allocation(arena);
+  if (allocator->alloc == NULL) {
+    return malloc(size);
+  }
+  return allocator->alloc(allocator->context, size);
+}
+
+/**
+ * @brief Releases @p ptr, which was allocated by @p allocator.
+ */
+static void Mem_free(const QInfo_allocator *allocator, void *ptr) {
+  if (allocator->alloc == NULL) {
+    free(ptr);
+  } else if (allocator->free != NULL && ptr != NULL) {
+    allocator->free(allocator->context, ptr);
+  }
+}
+
+/**
+ * @brief Resizes @p ptr, which was allocated by the allocator of @p arena, to
+ * @p size bytes, preserving its first @p used bytes.
+ * @details Allocators without a reallocation callback are served by a new
+ * allocation and a copy.
+ */
+static void *Mem_realloc(QInfo_arena_t *arena, void *ptr, const size_t used,
+                         const size_t size) {
+  const QInfo_allocator *allocator = &arena->allocator;
+  Stats_allocation(arena);
+  if (allocator->alloc == NULL) {
+    return realloc(ptr, size);
+  }
+  if (allocator->realloc != NULL) {
+    return allocator->realloc(allocator->context, ptr, used, size);
+  }
+  void *copy = allocator->alloc(allocator->context, size);
+  if (copy != NULL) {
+    memcpy(copy, ptr, used < size ? used : size);
+    Mem_free(allocator, ptr);
+  }
+  return copy;
+}
+
+static inline int Pages_for(const int size) {
+  return (size + QINFO_INTERNAL_PAGESLOTS - 1) / QINFO_INTERNAL_PAGESLOTS;
+}
+
+/**
+ * @brief Computes the number of slots of the page @p page in a value space of
+ * size @p size.
+ */
+static inline int Page_slots(const int size, const int page) {
+  const int rest = size - page * QINFO_INTERNAL_PAGESLOTS;
+  return rest < QINFO_INTERNAL_PAGESLOTS ? rest : QINFO_INTERNAL_PAGESLOTS;
+}
+
+static QInfo_page_t *Page_alloc(QInfo_arena_t *arena, const int num_slots) {
+  QInfo_page_t *page = (QInfo_page_t *)Mem_alloc(
+      arena, sizeof(QInfo_page_t) +
+      sizeof(QInfo_value_space_t) * (unsigned long)num_slots);
+  if (page == NULL) {
+    return NULL;
+  }
+  atomic_init(&page->refcount, 1);
+  return page;
+}
+
+static inline void Page_release(const QInfo_allocator *allocator,
+                                QInfo_page_t *page) {
+  if (Ref_release(&page->refcount)) {
+    Mem_free(allocator, page);
+  }
+}
+
+static QInfo_page_table_t *Table_alloc(QInfo_arena_t *arena,
+                                       const int num_pages) {
+  QInfo_page_table_t *table = (QInfo_page_table_t *)Mem_alloc(
+      arena, sizeof(QInfo_page_table_t) +
+      sizeof(QInfo_page_t *) * (unsigned long)num_pages);
+  if (table == NULL) {
+    return NULL;
+  }
+  atomic_init(&table->refcount, 1);
+  table->num_pages = 0;
+  return table;
+}
+
+static void Table_release(const QInfo_allocator *allocator,
+                          QInfo_page_table_t *table) {
+  if (!Ref_release(&table->refcount)) {
+    return;
+  }
+  for (int p = 0; p < table->num_pages; ++p) {
+    Page_release(allocator, table->pages[p]);
+  }
+  Mem_free(allocator, table);
+}
+
+/**
+ * @brief Creates a page table with all pages for a value space of size
+ * @p size.
+ */
+static QInfo_page_table_t *Table_create(QInfo_arena_t *arena,
+                                        const int size) {
+  const int num_pages = Pages_for(size);
+  QInfo_page_table_t *table = Table_alloc(arena, num_pages);
+  if (table == NULL) {
+    return NULL;
+  }
+  for (int p = 0; p < num_pages; ++p) {
+    table->pages[p] = Page_alloc(arena, Page_slots(size, p));
+    if (table->pages[p] == NULL) {
+      Table_release(&arena->allocator, table);
+      return NULL;
+    }
+    table->num_pages++;
+  }
+  return table;
+}
+
+/**
+ * @brief Makes the page table of @p info private to @p info.
+ * @details A shared page table is replaced by a copy that references the same
+ * pages, so only the pointers to the pages are copied.
+ */
+static int Table_own(QInfo info) {
+  QInfo_page_table_t *table = info->table;
+  if (!Is_shared(&table->refcount)) {
+    return QINFO_SUCCESS;
+  }
+
+  QInfo_page_table_t *copy =
+      Table_alloc(&info->arena, table->num_pages);
+  if (copy == NULL) {
     return QINFO_ERROR_OUTOFMEM;
   }
-
-  (*info_out)->size = info_in->size;
-  (*info_out)->num_occupied = info_in->num_occupied;
-
-  (*info_out)->value_space = (QInfo_value_space_t *)malloc(
-      sizeof(QInfo_value_space_t) * (unsigned long)(*info_out)->size);
-  if ((*info_out)->value_space == NULL) {
-    free(*info_out);
-    return QINFO_ERROR_OUTOFMEM;
+  for (int p = 0; p < table->num_pages; ++p) {
+    copy->pages[p] = table->pages[p];
+    Ref_acquire(&copy->pages[p]->refcount);
+  }
+  copy->num_pages = table->num_pages;
+  Table_release(&info->arena.allocator, table);
+  info->table = copy;
+  return QINFO_SUCCESS;
+}
+
+static inline QInfo_value_space_t *Space_slot(QInfo info, const int slot) {
+  return &info->table->pages[(unsigned)slot / QINFO_INTERNAL_PAGESLOTS]
+              ->slots[(unsigned)slot % QINFO_INTERNAL_PAGESLOTS];
+}
+
+/**
+ * @brief Gets the slot @p slot of @p info for writing.
+ * @details If the page of the slot is shared with a duplicate, it is copied
+ * first. Strings of the copied slots stay in the shared arena segments they
+ * were stored in and are treated as read-only.
+ * @return The slot, or NULL if memory could not be allocated.
+ */
+static QInfo_value_space_t *Space_slot_mut(QInfo info, const int slot) {
+  if (!QInfo_is_Success(Table_own(info))) {
+    return NULL;
+  }
+
+  const int p = (int)((unsigned)slot / QINFO_INTERNAL_PAGESLOTS);
+  QInfo_page_t *page = info->table->pages[p];
+  if (Is_shared(&page->refcount)) {
+    const int num_slots = Page_slots(info->size, p);
+    QInfo_page_t *copy = Page_alloc(&info->arena, num_slots);
+    if (copy == NULL) {
+      return NULL;
+    }
+    memcpy(copy->slots, page->slots,
+           sizeof(QInfo_value_space_t) * (unsigned long)num_slots);
+    Page_release(&info->arena.allocator, page);
+    info->table->pages[p] = copy;
+    page = copy;
+  }
+  return &page->slots[(unsigned)slot % QINFO_INTERNAL_PAGESLOTS];
+}
+
+/**
+ * @brief Finds the first occupied slot at or after @p slot.
+ * @details Skips 64 empty slots at a time and jumps directly to the next
+ * occupied slot within a word.
+ * @return The first occupied slot, or the size of the value space if there is
+ * none.
+ */
+static int Next_occupied(QInfo info, const int slot) {
+  if (slot >= info->num_used) {
+    return info->size;
+  }
+  int word = slot / QINFO_INTERNAL_WORDBITS;
+  uint64_t bits = info->index->occupied[word] &
+                  (~0ULL << (unsigned)(slot % QINFO_INTERNAL_WORDBITS));
+  const int last_word = Bitmap_words(info->num_used);
+  while (bits == 0) {
+    if (++word == last_word) {
+      return info->size;
+    }
+    bits = info->index->occupied[word];
+  }
+  return word * QINFO_INTERNAL_WORDBITS + Count_trailing_zeros(bits);
+}
+
+/**
+ * @brief Initial state of the key hash (64-bit FNV-1a offset basis).
+ */
+const uint64_t QINFO_INTERNAL_HASHBASIS = 0xcbf29ce484222325ULL;
+
+/**
+ * @brief Multiplier of the key hash (64-bit FNV-1a prime).
+ */
+const uint64_t QINFO_INTERNAL_HASHPRIME = 0x100000001b3ULL;
+
+/**
+ * @brief Finalizes the hash of a key.
+ * @details Applies the MurmurHash3 finalizer to the FNV-1a state, so that both
+ * the low bits (bucket position) and the high bits (bucket tag) are well
+ * mixed.
+ */
+static inline uint64_t Hash_finalize(uint64_t hash) {
+  hash ^= hash >> 33U;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33U;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33U;
+  return hash;
+}
+
+/**
+ * @brief Computes the hash of the @p length characters of @p key.
+ */
+static uint64_t Hash_key(const char *key, const size_t length) {
+  uint64_t hash = QINFO_INTERNAL_HASHBASIS;
+  const unsigned char *c = (const unsigned char *)key;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= c[i];
+    hash *= QINFO_INTERNAL_HASHPRIME;
+  }
+  return Hash_finalize(hash);
+}
+
+/**
+ * @brief Creates a key handle for the null-terminated @p key.
+ * @details Computes the length and the hash in a single pass.
+ */
+static void Key_from_cstr(const char *key, QInfo_key *handle) {
+  uint64_t hash = QINFO_INTERNAL_HASHBASIS;
+  const unsigned char *c = (const unsigned char *)key;
+  for (; *c != '\0'; ++c) {
+    hash ^= *c;
+    hash *= QINFO_INTERNAL_HASHPRIME;
+  }
+  handle->data = key;
+  handle->length = (size_t)((const char *)c - key);
+  handle->hash = Hash_finalize(hash);
+}
+
+/**
+ * @brief Copies @p length characters of @p str into a new null-terminated
+ * string.
+ */
+static char *Copy_string(const char *str, const size_t length) {
+  char *copy = (char *)malloc(length + 1);
+  if (copy == NULL) {
+    return NULL;
+  }
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+static inline size_t Arena_block_size(const size_t length) {
+  // Reserve room for the terminator and round up to whole granules.
+  return (length + QINFO_INTERNAL_ARENAGRANULE) &
+         ~(size_t)(QINFO_INTERNAL_ARENAGRANULE - 1);
+}
+
+static void Arena_init(QInfo_arena_t *arena,
+                       const QInfo_allocator *allocator) {
+  arena->allocator = *allocator;
+  arena->chunks = NULL;
+  for (int i = 0; i < QINFO_INTERNAL_ARENAFREECLASSES; ++i) {
+    arena->free[i] = NULL;
+  }
+  arena->live = 0;
+  arena->wasted = 0;
+  arena->shared = NULL;
+}
+
+static void Arena_free_chunks(const QInfo_allocator *allocator,
+                              QInfo_arena_chunk_t *chunks) {
+  while (chunks != NULL) {
+    QInfo_arena_chunk_t *next = chunks->next;
+    Mem_free(allocator, chunks);
+    chunks = next;
+  }
+}
+
+/**
+ * @brief Drops a reference to @p segment and frees all segments that are no
+ * longer referenced.
+ */
+static void Segment_release(QInfo_arena_segment_t *segment) {
+  while (segment != NULL && Ref_release(&segment->refcount)) {
+    QInfo_arena_segment_t *next = segment->next;
+    Segment_release(segment->merged);
+    Arena_free_chunks(&segment->allocator, segment->chunks);
+    Mem_free(&segment->allocator, segment);
+    segment = next;
+  }
+}
+
+static void Arena_destroy(QInfo_arena_t *arena) {
+  Arena_free_chunks(&arena->allocator, arena->chunks);
+  arena->chunks = NULL;
+  Segment_release(arena->shared);
+  arena->shared = NULL;
+}
+
+/**
+ * @brief Drops all strings of @p arena, but keeps its largest chunk for the
+ * strings written next.
+ */
+static void Arena_clear(QInfo_arena_t *arena) {
+  QInfo_arena_chunk_t *largest = NULL;
+  for (QInfo_arena_chunk_t *chunk = arena->chunks; chunk != NULL;) {
+    QInfo_arena_chunk_t *next = chunk->next;
+    if (largest == NULL || chunk->size > largest->size) {
+      Mem_free(&arena->allocator, largest);
+      largest = chunk;
+    } else {
+      Mem_free(&arena->allocator, chunk);
+    }
+    chunk = next;
+  }
+  Segment_release(arena->shared);
+
+  const QInfo_allocator allocator = arena->allocator;
+  Arena_init(arena, &allocator);
+  if (largest != NULL) {
+    largest->next = NULL;
+    largest->used = 0;
+    arena->chunks = largest;
+  }
+}
+
+/**
+ * @brief Freezes the chunks of @p arena into a segment that can be shared
+ * with a duplicate.
+ * @details Afterwards, @p arena starts over with no chunks of its own. Its
+ * previous strings remain valid, but are never modified or reused again.
+ */
+static int Arena_share(QInfo_arena_t *arena) {
+  if (arena->chunks == NULL) {
+    return QINFO_SUCCESS;
+  }
+
+  QInfo_arena_segment_t *segment = (QInfo_arena_segment_t *)Mem_alloc(
+      arena, sizeof(QInfo_arena_segment_t));
+  if (segment == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  atomic_init(&segment->refcount, 1);
+  segment->next = arena->shared;
+  segment->merged = NULL;
+  segment->chunks = arena->chunks;
+  segment->allocator = arena->allocator;
+
+  Arena_init(arena, &segment->allocator);
+  arena->shared = segment;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Makes the strings frozen in @p src valid for the lifetime of
+ * @p arena as well.
+ * @details A new segment without chunks of its own references the segments of
+ * @p src and is linked in front of the segments of @p arena.
+ */
+static int Arena_link(QInfo_arena_t *arena, QInfo_arena_segment_t *src) {
+  if (src == NULL) {
+    return QINFO_SUCCESS;
+  }
+
+  QInfo_arena_segment_t *segment = (QInfo_arena_segment_t *)Mem_alloc(
+      arena, sizeof(QInfo_arena_segment_t));
+  if (segment == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  atomic_init(&segment->refcount, 1);
+  segment->next = arena->shared;
+  segment->merged = src;
+  segment->chunks = NULL;
+  segment->allocator = arena->allocator;
+  Ref_acquire(&src->refcount);
+  arena->shared = segment;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Determines whether @p str lies in a chunk owned by @p arena rather
+ * than in a segment shared with duplicates.
+ */
+static int Arena_owns(const QInfo_arena_t *arena, const char *str) {
+  if (arena->shared == NULL) {
+    return 1;
+  }
+  const uintptr_t addr = (uintptr_t)str;
+  for (const QInfo_arena_chunk_t *chunk = arena->chunks; chunk != NULL;
+       chunk = chunk->next) {
+    if (addr >= (uintptr_t)chunk->data &&
+        addr < (uintptr_t)chunk->data + chunk->size) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Computes the capacity in bytes of the chunks owned by @p arena.
+ */
+static size_t Arena_chunk_bytes(const QInfo_arena_t *arena) {
+  size_t bytes = 0;
+  for (const QInfo_arena_chunk_t *chunk = arena->chunks; chunk != NULL;
+       chunk = chunk->next) {
+    bytes += sizeof(QInfo_arena_chunk_t) + chunk->size;
+  }
+  return bytes;
+}
+
+/**
+ * @brief Computes the number of bytes held by the chain of segments starting
+ * at @p segment, including the chains of merged objects.
+ * @details Bytes of segments that are referenced by other objects as well are
+ * also added to @p shared.
+ */
+static size_t Segment_bytes(QInfo_arena_segment_t *segment, size_t *shared) {
+  size_t total = 0;
+  for (; segment != NULL; segment = segment->next) {
+    size_t bytes = sizeof(QInfo_arena_segment_t);
+    for (const QInfo_arena_chunk_t *chunk = segment->chunks; chunk != NULL;
+         chunk = chunk->next) {
+      bytes += sizeof(QInfo_arena_chunk_t) + chunk->size;
+    }
+    if (Is_shared(&segment->refcount)) {
+      *shared += bytes;
+    }
+    total += bytes + Segment_bytes(segment->merged, shared);
+  }
+  return total;
+}
+
+/**
+ * @brief Computes the number of bytes held by @p info.
+ * @details Bytes of the page table, pages, hash index and arena segments that
+ * are referenced by other objects as well are also added to @p shared.
+ */
+static size_t Footprint(QInfo info, size_t *shared) {
+  size_t total = sizeof(QInfo_impl_t);
+  if (info->sync != NULL) {
+    total += sizeof(QInfo_sync_t);
+  }
+
+  QInfo_page_table_t *table = info->table;
+  size_t bytes = sizeof(QInfo_page_table_t) +
+                 sizeof(QInfo_page_t *) * (unsigned long)table->num_pages;
+  if (Is_shared(&table->refcount)) {
+    *shared += bytes;
+  }
+  total += bytes;
+  for (int p = 0; p < table->num_pages; ++p) {
+    bytes = sizeof(QInfo_page_t) + sizeof(QInfo_value_space_t) *
+                                       (unsigned long)Page_slots(info->size, p);
+    if (Is_shared(&table->pages[p]->refcount)) {
+      *shared += bytes;
+    }
+    total += bytes;
+  }
+
+  if (info->profile != NULL) {
+    total += sizeof(atomic_ullong) * (unsigned long)info->size;
+  }
+
+  QInfo_index_t *index = info->index;
+  bytes = sizeof(QInfo_index_t) +
+          sizeof(QInfo_hash_bucket_t) * (unsigned long)index->num_buckets +
+          sizeof(uint64_t) * (unsigned long)Bitmap_words(info->size);
+  if (Is_shared(&index->refcount)) {
+    *shared += bytes;
+  }
+  total += bytes;
+
+  return total + Arena_chunk_bytes(&info->arena) +
+         Segment_bytes(info->arena.shared, shared);
+}
+
+#ifdef QINFO_ENABLE_STATS
+/**
+ * @brief Records a lookup in @p info that inspected @p probes buckets.
+ */
+static inline void Stats_lookup(QInfo info, const unsigned long long probes,
+                                const int hit) {
+  QInfo_counters_t *counters = &info->arena.counters;
+  atomic_fetch_add_explicit(&counters->lookups, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&counters->hits, (unsigned long long)hit,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&counters->probes, probes, memory_order_relaxed);
+  unsigned long long longest =
+      atomic_load_explicit(&counters->max_probe, memory_order_relaxed);
+  while (probes > longest &&
+         !atomic_compare_exchange_weak_explicit(&counters->max_probe, &longest,
+                                                probes, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+static inline void Stats_growth(QInfo info) {
+  info->arena.counters.growths++;
+}
+
+/**
+ * @brief Updates the peak footprint of @p info with its current footprint.
+ * @details The footprint without the own chunks of the arena is remembered,
+ * so that new chunks can be accounted for without a full recount.
+ */
+static void Stats_sample(QInfo info) {
+  QInfo_counters_t *counters = &info->arena.counters;
+  size_t shared = 0;
+  const size_t total = Footprint(info, &shared);
+  counters->base_bytes = total - Arena_chunk_bytes(&info->arena);
+  if (total > counters->peak_bytes) {
+    counters->peak_bytes = total;
+  }
+}
+
+/**
+ * @brief Updates the peak footprint of the object of @p arena after a new
+ * chunk was added to @p arena.
+ */
+static void Stats_chunk(QInfo_arena_t *arena) {
+  QInfo_counters_t *counters = &arena->counters;
+  const size_t total = counters->base_bytes + Arena_chunk_bytes(arena);
+  if (total > counters->peak_bytes) {
+    counters->peak_bytes = total;
+  }
+}
+#else
+static inline void Stats_lookup(QInfo info, const unsigned long long probes,
+                                const int hit) {
+  (void)info;
+  (void)probes;
+  (void)hit;
+}
+
+static inline void Stats_growth(QInfo info) { (void)info; }
+
+static inline void Stats_sample(QInfo info) { (void)info; }
+
+static inline void Stats_chunk(QInfo_arena_t *arena) { (void)arena; }
+#endif
+
+/**
+ * @brief Makes sure that the current chunk of @p arena has room for @p bytes
+ * more bytes.
+ * @details Chunks grow geometrically up to QINFO_INTERNAL_ARENAMAXCHUNK, and
+ * are never smaller than the requested size.
+ */
+static int Arena_reserve(QInfo_arena_t *arena, const size_t bytes) {
+  if (arena->chunks != NULL &&
+      arena->chunks->size - arena->chunks->used >= bytes) {
+    return QINFO_SUCCESS;
+  }
+
+  size_t size = QINFO_INTERNAL_ARENACHUNK;
+  if (arena->chunks != NULL) {
+    size = arena->chunks->size < QINFO_INTERNAL_ARENAMAXCHUNK / 2
+               ? arena->chunks->size * 2
+               : QINFO_INTERNAL_ARENAMAXCHUNK;
+  }
+  if (size < bytes) {
+    size = bytes;
+  }
+
+  QInfo_arena_chunk_t *chunk = (QInfo_arena_chunk_t *)Mem_alloc(
+      arena, sizeof(QInfo_arena_chunk_t) + size);
+  if (chunk == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  chunk->next = arena->chunks;
+  chunk->size = size;
+  chunk->used = 0;
+  arena->chunks = chunk;
+  Stats_chunk(arena);
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Copies @p length characters of @p str into a new null-terminated
+ * string in @p arena.
+ */
+static char *Arena_copy_string(QInfo_arena_t *arena, const char *str,
+                               const size_t length) {
+  const size_t size = Arena_block_size(length);
+  const size_t cls = size / QINFO_INTERNAL_ARENAGRANULE - 1;
+
+  char *block = NULL;
+  if (cls < QINFO_INTERNAL_ARENAFREECLASSES && arena->free[cls] != NULL) {
+    block = arena->free[cls];
+    memcpy((void *)&arena->free[cls], block, sizeof(char *));
+    arena->wasted -= size;
+  } else {
+    if (!QInfo_is_Success(Arena_reserve(arena, size))) {
+      return NULL;
+    }
+    block = arena->chunks->data + arena->chunks->used;
+    arena->chunks->used += size;
+  }
+  arena->live += size;
+
+  memcpy(block, str, length);
+  block[length] = '\0';
+  return block;
+}
+
+/**
+ * @brief Returns the block holding a string of length @p length to @p arena.
+ */
+static void Arena_release(QInfo_arena_t *arena, char *str,
+                          const size_t length) {
+  if (str == NULL) {
+    return;
+  }
+  const size_t size = Arena_block_size(length);
+  const size_t cls = size / QINFO_INTERNAL_ARENAGRANULE - 1;
+  if (cls < QINFO_INTERNAL_ARENAFREECLASSES) {
+    memcpy(str, (const void *)&arena->free[cls], sizeof(char *));
+    arena->free[cls] = str;
+  }
+  arena->live -= size;
+  arena->wasted += size;
+}
+
+static inline unsigned String_tag(const QInfo_string *str) {
+  return (unsigned char)str->buffer[QINFO_INTERNAL_INLINESTRING - 1];
+}
+
+static inline int String_is_inline(const QInfo_string *str) {
+  return String_tag(str) < QINFO_INTERNAL_INLINESTRING;
+}
+
+static inline const char *String_data(const QInfo_string *str) {
+  return String_is_inline(str) ? str->buffer : str->heap.data;
+}
+
+static inline uint32_t String_length(const QInfo_string *str) {
+  return String_is_inline(str)
+             ? QINFO_INTERNAL_INLINESTRING - 1 - String_tag(str)
+             : str->heap.length;
+}
+
+/**
+ * @brief Marks @p str as unset.
+ */
+static inline void String_unset(QInfo_string *str) {
+  str->heap.data = NULL;
+  str->heap.length = 0;
+  str->heap.tag = QINFO_INTERNAL_HEAPSTRING;
+}
+
+/**
+ * @brief Stores @p length characters of @p src in @p str.
+ * @details Short strings are stored inline, longer ones in @p arena. Any
+ * previous content of @p str must have been released already.
+ */
+static int String_assign(QInfo_arena_t *arena, QInfo_string *str,
+                         const char *src, const size_t length) {
+  if (length < QINFO_INTERNAL_INLINESTRING) {
+    memcpy(str->buffer, src, length);
+    str->buffer[length] = '\0';
+    str->buffer[QINFO_INTERNAL_INLINESTRING - 1] =
+        (char)(QINFO_INTERNAL_INLINESTRING - 1 - length);
+    return QINFO_SUCCESS;
+  }
+
+  char *data = Arena_copy_string(arena, src, length);
+  if (data == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  str->heap.data = data;
+  str->heap.length = (uint32_t)length;
+  str->heap.tag = QINFO_INTERNAL_HEAPSTRING;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Returns the arena storage of @p str, if any, to @p arena.
+ * @details Strings in segments shared with duplicates are left untouched.
+ */
+static inline void String_release(QInfo_arena_t *arena,
+                                  const QInfo_string *str) {
+  if (!String_is_inline(str) && Arena_owns(arena, str->heap.data)) {
+    Arena_release(arena, str->heap.data, str->heap.length);
+  }
+}
+
+/**
+ * @brief Determines whether values of type @p type are arrays.
+ * @details Blobs are stored as arrays of bytes.
+ */
+static inline int Type_is_array(const enum QINFO_TYPE type) {
+  return type >= QINFO_TYPE_INT32_ARRAY && type <= QINFO_TYPE_BLOB;
+}
+
+/**
+ * @brief Returns the size in bytes of an element of an array of type
+ * @p type.
+ */
+static inline size_t Array_element_size(const enum QINFO_TYPE type) {
+  switch (type) {
+  case QINFO_TYPE_INT32_ARRAY:
+  case QINFO_TYPE_FLOAT_ARRAY:
+    return 4;
+  case QINFO_TYPE_BLOB:
+    return 1;
+  default:
+    return 8;
+  }
+}
+
+/**
+ * @brief Allocates a block for @p bytes bytes of array elements in @p arena.
+ * @details Array blocks start at a multiple of QINFO_INTERNAL_ARRAYALIGN.
+ * They are always bumped from the current chunk, since released blocks are not
+ * aligned, and the bytes skipped for the alignment count as wasted. Released
+ * array blocks are reused for strings like any other block.
+ * @return The block, or NULL if memory could not be allocated.
+ */
+static void *Arena_alloc_array(QInfo_arena_t *arena, const size_t bytes) {
+  const size_t size = Arena_block_size(bytes);
+  const size_t padded =
+      size + QINFO_INTERNAL_ARRAYALIGN - QINFO_INTERNAL_ARENAGRANULE;
+  if (!QInfo_is_Success(Arena_reserve(arena, padded))) {
+    return NULL;
+  }
+  QInfo_arena_chunk_t *chunk = arena->chunks;
+  const size_t misalignment =
+      (uintptr_t)(chunk->data + chunk->used) % QINFO_INTERNAL_ARRAYALIGN;
+  if (misalignment != 0) {
+    chunk->used += QINFO_INTERNAL_ARRAYALIGN - misalignment;
+    arena->wasted += QINFO_INTERNAL_ARRAYALIGN - misalignment;
+  }
+  char *block = chunk->data + chunk->used;
+  chunk->used += size;
+  arena->live += size;
+  return block;
+}
+
+/**
+ * @brief Returns the arena storage of @p array of type @p type, if any, to
+ * @p arena.
+ * @details Arrays in segments shared with duplicates are left untouched.
+ */
+static inline void Array_release(QInfo_arena_t *arena,
+                                 const QInfo_array *array,
+                                 const enum QINFO_TYPE type) {
+  if (array->data != NULL && Arena_owns(arena, (const char *)array->data)) {
+    Arena_release(arena, (char *)array->data,
+                  (size_t)array->count * Array_element_size(type));
+  }
+}
+
+static inline uint32_t Hash_tag(const uint64_t hash) {
+  return (uint32_t)(hash >> 32U);
+}
+
+static void Index_reset_buckets(QInfo_hash_bucket_t *buckets,
+                                const uint32_t num_buckets) {
+  for (uint32_t i = 0; i < num_buckets; ++i) {
+    buckets[i].tag = 0;
+    buckets[i].index = QINFO_INTERNAL_EMPTYBUCKET;
+  }
+}
+
+static QInfo_hash_bucket_t *Index_alloc(QInfo_arena_t *arena,
+                                        const uint32_t num_buckets) {
+  QInfo_hash_bucket_t *buckets = (QInfo_hash_bucket_t *)Mem_alloc(
+      arena, sizeof(QInfo_hash_bucket_t) * (unsigned long)num_buckets);
+  if (buckets == NULL) {
+    return NULL;
+  }
+  Index_reset_buckets(buckets, num_buckets);
+  return buckets;
+}
+
+static void Index_release(const QInfo_allocator *allocator,
+                          QInfo_index_t *index) {
+  if (!Ref_release(&index->refcount)) {
+    return;
+  }
+  Mem_free(allocator, index->buckets);
+  Mem_free(allocator, index->occupied);
+  Mem_free(allocator, index);
+}
+
+/**
+ * @brief Creates an empty hash index with @p num_buckets buckets and an
+ * occupancy bitmap for a value space of size @p size.
+ */
+static QInfo_index_t *Index_create(QInfo_arena_t *arena,
+                                   const uint32_t num_buckets,
+                                   const int size) {
+  const QInfo_allocator *allocator = &arena->allocator;
+  QInfo_index_t *index =
+      (QInfo_index_t *)Mem_alloc(arena, sizeof(QInfo_index_t));
+  if (index == NULL) {
+    return NULL;
+  }
+  const size_t words = (size_t)Bitmap_words(size);
+  atomic_init(&index->refcount, 1);
+  index->num_buckets = num_buckets;
+  index->buckets = Index_alloc(arena, num_buckets);
+  index->occupied = (uint64_t *)Mem_alloc(arena, sizeof(uint64_t) * words);
+  if (index->buckets == NULL || index->occupied == NULL) {
+    Mem_free(allocator, index->buckets);
+    Mem_free(allocator, index->occupied);
+    Mem_free(allocator, index);
+    return NULL;
+  }
+  memset(index->occupied, 0, sizeof(uint64_t) * words);
+  return index;
+}
+
+/**
+ * @brief Makes the hash index and the occupancy bitmap of @p info private to
+ * @p info.
+ * @details A shared index is replaced by a copy.
+ */
+static int Index_own(QInfo info) {
+  QInfo_index_t *index = info->index;
+  if (!Is_shared(&index->refcount)) {
+    return QINFO_SUCCESS;
+  }
+
+  const QInfo_allocator *allocator = &info->arena.allocator;
+  QInfo_index_t *copy =
+      (QInfo_index_t *)Mem_alloc(&info->arena, sizeof(QInfo_index_t));
+  if (copy == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  const size_t words = (size_t)Bitmap_words(info->size);
+  copy->buckets = (QInfo_hash_bucket_t *)Mem_alloc(
+      &info->arena,
+      sizeof(QInfo_hash_bucket_t) * (unsigned long)index->num_buckets);
+  copy->occupied =
+      (uint64_t *)Mem_alloc(&info->arena, sizeof(uint64_t) * words);
+  if (copy->buckets == NULL || copy->occupied == NULL) {
+    Mem_free(allocator, copy->buckets);
+    Mem_free(allocator, copy->occupied);
+    Mem_free(allocator, copy);
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  atomic_init(&copy->refcount, 1);
+  copy->num_buckets = index->num_buckets;
+  memcpy(copy->buckets, index->buckets,
+         sizeof(QInfo_hash_bucket_t) * (unsigned long)index->num_buckets);
+  memcpy(copy->occupied, index->occupied, sizeof(uint64_t) * words);
+  Index_release(allocator, index);
+  info->index = copy;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Looks up the slot of @p key in the hash index.
+ * @return The slot of the key, or -1 if the key is not present.
+ */
+static int Index_find(QInfo info, const QInfo_key *key) {
+  const QInfo_hash_bucket_t *buckets = info->index->buckets;
+  const uint32_t mask = info->index->num_buckets - 1;
+  const uint32_t tag = Hash_tag(key->hash);
+  unsigned long long probes = 0;
+  for (uint32_t pos = (uint32_t)key->hash & mask;; pos = (pos + 1) & mask) {
+    const QInfo_hash_bucket_t *bucket = &buckets[pos];
+    ++probes;
+    if (bucket->index == QINFO_INTERNAL_EMPTYBUCKET) {
+      Stats_lookup(info, probes, 0);
+      return -1;
+    }
+    if (bucket->tag != tag) {
+      continue;
+    }
+    const QInfo_string *name = &Space_slot(info, bucket->index)->name;
+    if (String_length(name) == key->length &&
+        memcmp(String_data(name), key->data, key->length) == 0) {
+      Stats_lookup(info, probes, 1);
+      return bucket->index;
+    }
+  }
+}
+
+/**
+ * @brief Inserts the slot @p index into the hash index.
+ * @details The key must not be present in the index yet and the index must
+ * have at least one empty bucket. The index must be private to @p info.
+ */
+static void Index_insert(QInfo info, const uint64_t hash,
+                         const QInfo_index index) {
+  QInfo_hash_bucket_t *buckets = info->index->buckets;
+  const uint32_t mask = info->index->num_buckets - 1;
+  uint32_t pos = (uint32_t)hash & mask;
+  while (buckets[pos].index != QINFO_INTERNAL_EMPTYBUCKET) {
+    pos = (pos + 1) & mask;
+  }
+  buckets[pos].tag = Hash_tag(hash);
+  buckets[pos].index = index;
+}
+
+/**
+ * @brief Removes the slot @p index from the hash index.
+ * @details Uses backward-shift deletion so that no tombstones are needed and
+ * probe sequences stay short under heavy remove/add churn. The index must be
+ * private to @p info.
+ */
+static void Index_erase(QInfo info, const uint64_t hash,
+                        const QInfo_index index) {
+  QInfo_hash_bucket_t *buckets = info->index->buckets;
+  const uint32_t mask = info->index->num_buckets - 1;
+  uint32_t pos = (uint32_t)hash & mask;
+  while (buckets[pos].index != index) {
+    pos = (pos + 1) & mask;
+  }
+
+  for (uint32_t next = (pos + 1) & mask;; next = (next + 1) & mask) {
+    const QInfo_hash_bucket_t *bucket = &buckets[next];
+    if (bucket->index == QINFO_INTERNAL_EMPTYBUCKET) {
+      break;
+    }
+    // Only move the entry back if its home bucket does not lie cyclically
+    // within (pos, next].
+    const uint32_t home =
+        (uint32_t)Space_slot(info, bucket->index)->hash & mask;
+    if (((next - home) & mask) >= ((next - pos) & mask)) {
+      buckets[pos] = *bucket;
+      pos = next;
+    }
+  }
+  buckets[pos].tag = 0;
+  buckets[pos].index = QINFO_INTERNAL_EMPTYBUCKET;
+}
+
+/**
+ * @brief Computes the number of buckets needed to index @p num_keys keys.
+ * @details The index is kept at a load factor of at most 3/4.
+ */
+static uint32_t Index_buckets_for(uint32_t num_buckets, const int num_keys) {
+  while ((uint64_t)num_keys * 4 > (uint64_t)num_buckets * 3 &&
+         num_buckets < (1U << 31U)) {
+    num_buckets *= 2;
+  }
+  return num_buckets;
+}
+
+/**
+ * @brief Grows the hash index such that it can hold @p num_keys keys.
+ * @details The index must be private to @p info.
+ */
+static int Index_reserve(QInfo info, const int num_keys) {
+  const uint32_t num_buckets =
+      Index_buckets_for(info->index->num_buckets, num_keys);
+  if (num_buckets == info->index->num_buckets) {
+    return QINFO_SUCCESS;
+  }
+
+  QInfo_hash_bucket_t *buckets =
+      Index_alloc(&info->arena, num_buckets);
+  if (buckets == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  Mem_free(&info->arena.allocator, info->index->buckets);
+  info->index->buckets = buckets;
+  info->index->num_buckets = num_buckets;
+  Stats_growth(info);
+
+  for (int i = Next_occupied(info, 0); i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    Index_insert(info, Space_slot(info, i)->hash, i);
+  }
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Allocates the pages of @p info for a value space of size
+ * @p capacity.
+ * @details Existing pages are kept, except for a partially allocated last
+ * page, which is replaced by a larger one. On failure, all newly allocated
+ * pages are released again.
+ */
+static int Space_grow_pages(QInfo info, const int capacity) {
+  if (!QInfo_is_Success(Table_own(info))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  const QInfo_allocator *allocator = &info->arena.allocator;
+  const int num_pages = Pages_for(capacity);
+  if (num_pages > info->table->num_pages) {
+    QInfo_page_table_t *table = (QInfo_page_table_t *)Mem_realloc(
+        &info->arena, info->table,
+        sizeof(QInfo_page_table_t) +
+            sizeof(QInfo_page_t *) * (unsigned long)info->table->num_pages,
+        sizeof(QInfo_page_table_t) +
+            sizeof(QInfo_page_t *) * (unsigned long)num_pages);
+    if (table == NULL) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    info->table = table;
+  }
+
+  const int last = Pages_for(info->size) - 1;
+  const int last_slots = Page_slots(info->size, last);
+  if (last_slots < Page_slots(capacity, last)) {
+    QInfo_page_t *page =
+        Page_alloc(&info->arena, Page_slots(capacity, last));
+    if (page == NULL) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    memcpy(page->slots, info->table->pages[last]->slots,
+           sizeof(QInfo_value_space_t) * (unsigned long)last_slots);
+    Page_release(allocator, info->table->pages[last]);
+    info->table->pages[last] = page;
+  }
+
+  while (info->table->num_pages < num_pages) {
+    const int p = info->table->num_pages;
+    info->table->pages[p] =
+        Page_alloc(&info->arena, Page_slots(capacity, p));
+    if (info->table->pages[p] == NULL) {
+      while (info->table->num_pages > last + 1) {
+        Page_release(allocator, info->table->pages[--info->table->num_pages]);
+      }
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    info->table->num_pages++;
+  }
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Returns the maximum number of slots of @p info.
+ * @details The slots of a layered object must fit into the low bits of its
+ * indices, see QINFO_INTERNAL_LAYERSHIFT.
+ */
+static inline int Space_limit(QInfo info) {
+  return info->parent != NULL ? QINFO_INTERNAL_LAYERSLOTS : INT_MAX;
+}
+
+/**
+ * @brief Grows the value space and the hash index of @p info such that it can
+ * hold at least @p capacity entries.
+ * @details Both are reallocated at most once. Existing slots keep their
+ * positions, so previously returned indices remain valid.
+ */
+static int Space_reserve(QInfo info, const int capacity) {
+  if (capacity > Space_limit(info)) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  if (capacity <= info->size &&
+      Index_buckets_for(info->index->num_buckets, capacity) ==
+          info->index->num_buckets) {
+    return QINFO_SUCCESS;
+  }
+  if (!QInfo_is_Success(Index_own(info)) ||
+      !QInfo_is_Success(Index_reserve(info, capacity))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  if (capacity <= info->size) {
+    Stats_sample(info);
+    return QINFO_SUCCESS;
+  }
+
+  const int old_words = Bitmap_words(info->size);
+  const int new_words = Bitmap_words(capacity);
+  if (new_words > old_words) {
+    uint64_t *new_occupied = (uint64_t *)Mem_realloc(
+        &info->arena, info->index->occupied,
+        sizeof(uint64_t) * (unsigned long)old_words,
+        sizeof(uint64_t) * (unsigned long)new_words);
+    if (new_occupied == NULL) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    info->index->occupied = new_occupied;
+    memset(info->index->occupied + old_words, 0,
+           sizeof(uint64_t) * (unsigned long)(new_words - old_words));
+  }
+
+  if (info->profile != NULL) {
+    atomic_ullong *profile = (atomic_ullong *)Mem_realloc(
+        &info->arena, info->profile,
+        sizeof(atomic_ullong) * (unsigned long)info->size,
+        sizeof(atomic_ullong) * (unsigned long)capacity);
+    if (profile == NULL) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    for (int i = info->size; i < capacity; ++i) {
+      atomic_init(&profile[i], 0);
+    }
+    info->profile = profile;
+  }
+
+  if (!QInfo_is_Success(Space_grow_pages(info, capacity))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  info->size = capacity;
+  Stats_growth(info);
+  Stats_sample(info);
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Takes an unoccupied slot from @p info for writing.
+ * @details Vacated slots are reused first (most recently vacated first), then
+ * slots that have never been used. The value space must not be full.
+ * @return The slot, or NULL if memory could not be allocated.
+ */
+static QInfo_value_space_t *Space_take_slot(QInfo info, QInfo_index *index) {
+  const int i = info->free_head != QINFO_INTERNAL_NOSLOT ? info->free_head
+                                                         : info->num_used;
+  QInfo_value_space_t *slot = Space_slot_mut(info, i);
+  if (slot == NULL) {
+    return NULL;
+  }
+  if (i == info->free_head) {
+    info->free_head = slot->value.value_i32;
+  } else {
+    info->num_used++;
+  }
+  *index = i;
+  return slot;
+}
+
+/**
+ * @brief Records a lookup of the key in the slot @p slot, if @p info is
+ * profiled.
+ */
+static inline void Profile_hit(QInfo info, const int slot) {
+  if (info->profile != NULL) {
+    atomic_fetch_add_explicit(&info->profile[slot], 1, memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Forgets the lookups of the key in the slot @p slot, which is about
+ * to be vacated.
+ */
+static inline void Profile_reset(QInfo info, const int slot) {
+  if (info->profile != NULL) {
+    atomic_store_explicit(&info->profile[slot], 0, memory_order_relaxed);
+  }
+}
+
+int QInfo_create(QInfo *info) {
+  return QInfo_create_with_capacity(info, QINFO_INTERNAL_INITIALSPACE);
+}
+
+int QInfo_create_with_capacity(QInfo *info, const int capacity) {
+  return QInfo_create_with_allocator(info, capacity, NULL);
+}
+
+int QInfo_create_with_allocator(QInfo *info, const int capacity,
+                                const QInfo_allocator *allocator) {
+  if (capacity < 0) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  static const QInfo_allocator system = {NULL, NULL, NULL, NULL};
+  if (allocator == NULL) {
+    allocator = &system;
+  }
+
+  QInfo_arena_t arena;
+  Arena_init(&arena, allocator);
+  Stats_init(&arena);
+  QInfo out = (QInfo_impl_t *)Mem_alloc(&arena, sizeof(QInfo_impl_t));
+  if (out == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  // Always allocate at least one slot so that malloc is never asked for zero
+  // bytes.
+  out->size = capacity > 0 ? capacity : 1;
+  out->num_occupied = 0;
+  out->num_used = 0;
+  out->free_head = QINFO_INTERNAL_NOSLOT;
+  out->sync = NULL;
+  out->parent = NULL;
+  out->depth = 0;
+  out->profile = NULL;
+  out->owner = NULL;
+  out->num_children = 0;
+  out->arena = arena;
+
+  out->index = Index_create(
+      &out->arena,
+      Index_buckets_for((uint32_t)QINFO_INTERNAL_INDEXBUCKETS, capacity),
+      out->size);
+  if (out->index == NULL) {
+    Mem_free(allocator, out);
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  out->table = Table_create(&out->arena, out->size);
+  if (out->table == NULL) {
+    Index_release(allocator, out->index);
+    Mem_free(allocator, out);
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  Stats_sample(out);
+
+  *info = out;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_create_concurrent(QInfo *info) {
+  QInfo_sync_t *sync = (QInfo_sync_t *)calloc(1, sizeof(QInfo_sync_t));
+  if (sync == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  const int err = QInfo_create(info);
+  if (!QInfo_is_Success(err)) {
+    free(sync);
+    return err;
+  }
+  (*info)->sync = sync;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_create_layered(QInfo parent, QInfo *child) {
+  if (parent->depth == QINFO_INTERNAL_MAXLAYERS) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+
+  const int err = QInfo_create(child);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  (*child)->parent = parent;
+  (*child)->depth = parent->depth + 1;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Copies the key and string value of every occupied slot of @p info
+ * that is stored in a chunk owned by the arena of @p info into the current
+ * chunk of @p arena.
+ * @details Array values are copied as well. The chunk must have room for all
+ * these strings and arrays. Used by QInfo_compact to pack all strings into a
+ * single chunk. Owned strings are
+ * only ever referenced from pages private to @p info, so the slots can be
+ * updated in place.
+ */
+static void Space_copy_strings(QInfo info, QInfo_arena_t *arena) {
+  for (int i = Next_occupied(info, 0); i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    QInfo_value_space_t *slot = Space_slot(info, i);
+    if (!String_is_inline(&slot->name) &&
+        Arena_owns(&info->arena, slot->name.heap.data)) {
+      slot->name.heap.data = Arena_copy_string(arena, slot->name.heap.data,
+                                               slot->name.heap.length);
+    }
+    if (slot->type == QINFO_TYPE_STRING &&
+        !String_is_inline(&slot->value.value_string) &&
+        slot->value.value_string.heap.data != NULL &&
+        Arena_owns(&info->arena, slot->value.value_string.heap.data)) {
+      slot->value.value_string.heap.data =
+          Arena_copy_string(arena, slot->value.value_string.heap.data,
+                            slot->value.value_string.heap.length);
+    }
+    QInfo_array *array = &slot->value.value_array;
+    if (Type_is_array(slot->type) && array->data != NULL &&
+        Arena_owns(&info->arena, (const char *)array->data)) {
+      const size_t bytes =
+          (size_t)array->count * Array_element_size(slot->type);
+      void *data = Arena_alloc_array(arena, bytes);
+      memcpy(data, array->data, bytes);
+      array->data = data;
+    }
+  }
+}
+
+/**
+ * @brief Counts the array values of @p info that are stored in a chunk owned
+ * by the arena of @p info.
+ */
+static size_t Space_owned_arrays(QInfo info) {
+  size_t count = 0;
+  for (int i = Next_occupied(info, 0); i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    const QInfo_value_space_t *slot = Space_slot(info, i);
+    if (Type_is_array(slot->type) && slot->value.value_array.data != NULL &&
+        Arena_owns(&info->arena,
+                   (const char *)slot->value.value_array.data)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Frees the nested object @p child of @p info, if any.
+ */
+static void Child_release(QInfo info, QInfo child) {
+  if (child != NULL) {
+    child->owner = NULL;
+    QInfo_free(child);
+    info->num_children--;
+  }
+}
+
+/**
+ * @brief Frees the nested objects of the occupied slots of @p info below
+ * @p end.
+ * @details The slots keep the stale handles.
+ */
+static void Free_children(QInfo info, const int end) {
+  for (int i = Next_occupied(info, 0); info->num_children > 0 && i < end;
+       i = Next_occupied(info, i + 1)) {
+    const QInfo_value_space_t *slot = Space_slot(info, i);
+    if (slot->type == QINFO_TYPE_QINFO) {
+      Child_release(info, slot->value.value_qinfo);
+    }
+  }
+}
+
+/**
+ * @brief Replaces the nested objects of @p info, which still belong to the
+ * object @p info was duplicated from, by duplicates.
+ * @details On failure, the duplicates made so far are freed again.
+ */
+static int Duplicate_children(QInfo info) {
+  for (int i = Next_occupied(info, 0); info->num_children > 0 && i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    const QInfo_value_space_t *from = Space_slot(info, i);
+    if (from->type != QINFO_TYPE_QINFO || from->value.value_qinfo == NULL) {
+      continue;
+    }
+    QInfo copy = NULL;
+    int err = QInfo_duplicate(from->value.value_qinfo, &copy);
+    QInfo_value_space_t *slot =
+        QInfo_is_Success(err) ? Space_slot_mut(info, i) : NULL;
+    if (slot == NULL) {
+      if (copy != NULL) {
+        QInfo_free(copy);
+        err = QINFO_ERROR_OUTOFMEM;
+      }
+      Free_children(info, i);
+      return err;
+    }
+    slot->value.value_qinfo = copy;
+    copy->owner = info;
+  }
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Frees the storage of @p info, but not its nested objects.
+ */
+static void Destroy(QInfo info) {
+  const QInfo_allocator allocator = info->arena.allocator;
+  free(info->sync);
+  Mem_free(&allocator, info->profile);
+  Arena_destroy(&info->arena);
+  Index_release(&allocator, info->index);
+  Table_release(&allocator, info->table);
+  Mem_free(&allocator, info);
+}
+
+static int Duplicate(QInfo info_in, QInfo *info_out) {
+  QInfo out =
+      (QInfo_impl_t *)Mem_alloc(&info_in->arena, sizeof(QInfo_impl_t));
+  if (out == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  // The duplicate shares all storage with info_in. Whichever object modifies
+  // the page table, a page, or the hash index first copies it. Strings written
+  // so far are frozen into an arena segment that both objects reference.
+  const int err = Arena_share(&info_in->arena);
+  if (!QInfo_is_Success(err)) {
+    Mem_free(&info_in->arena.allocator, out);
+    return err;
+  }
+  *out = *info_in;
+  out->sync = NULL;
+  out->profile = NULL;
+  out->owner = NULL;
+  Ref_acquire(&out->table->refcount);
+  Ref_acquire(&out->index->refcount);
+  if (out->arena.shared != NULL) {
+    Ref_acquire(&out->arena.shared->refcount);
+  }
+  Stats_init(&out->arena);
+
+  // Nested objects are not shared, each of them has a single owner.
+  const int err_children = Duplicate_children(out);
+  if (!QInfo_is_Success(err_children)) {
+    Destroy(out);
+    return err_children;
+  }
+  Stats_sample(out);
+  Stats_sample(info_in);
+
+  *info_out = out;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_duplicate(QInfo info_in, QInfo *info_out) {
+  Write_lock(info_in);
+  const int err = Duplicate(info_in, info_out);
+  Write_unlock(info_in);
+  return err;
+}
+
+int QInfo_free(QInfo info) {
+  if (info->owner != NULL) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+  Free_children(info, info->size);
+  Destroy(info);
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Empties the hash index and the occupancy bitmap of @p info.
+ * @details A shared index is replaced by a new, empty one of the same size
+ * instead of being copied.
+ */
+static int Index_clear(QInfo info) {
+  QInfo_index_t *index = info->index;
+  if (Is_shared(&index->refcount)) {
+    QInfo_index_t *empty =
+        Index_create(&info->arena, index->num_buckets, info->size);
+    if (empty == NULL) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    Index_release(&info->arena.allocator, index);
+    info->index = empty;
+    return QINFO_SUCCESS;
+  }
+  Index_reset_buckets(index->buckets, index->num_buckets);
+  memset(index->occupied, 0,
+         sizeof(uint64_t) * (unsigned long)Bitmap_words(info->size));
+  return QINFO_SUCCESS;
+}
+
+static int Clear(QInfo info) {
+  // Nested objects are found through the occupancy bitmap, which must not be
+  // replaced before they are freed.
+  if (info->num_children > 0) {
+    if (!QInfo_is_Success(Index_own(info))) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    Free_children(info, info->size);
+  }
+
+  const int err = Index_clear(info);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  // The slots keep their stale contents. They are unoccupied and only ever
+  // written before they are read again, and pages shared with duplicates are
+  // copied first as usual.
+  Arena_clear(&info->arena);
+  for (int i = 0; info->profile != NULL && i < info->size; ++i) {
+    Profile_reset(info, i);
+  }
+  info->num_occupied = 0;
+  info->num_used = 0;
+  info->free_head = QINFO_INTERNAL_NOSLOT;
+  Stats_sample(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_clear(QInfo info) {
+  Write_lock(info);
+  const int err = Clear(info);
+  Write_unlock(info);
+  return err;
+}
+
+/**
+ * @brief Internal structure for the recycling pool of a thread.
+ */
+typedef struct QInfo_pool_d {
+  int count;                              /**< The number of objects. */
+  QInfo objects[QINFO_INTERNAL_POOLSIZE]; /**< The pooled objects. */
+} QInfo_pool_t;
+
+static _Thread_local QInfo_pool_t Thread_pool;
+
+int QInfo_acquire(QInfo *info) {
+  if (Thread_pool.count > 0) {
+    *info = Thread_pool.objects[--Thread_pool.count];
+    return QINFO_SUCCESS;
+  }
+  return QInfo_create(info);
+}
+
+int QInfo_release(QInfo info) {
+  // Only objects that QInfo_acquire could have created are pooled.
+  if (Thread_pool.count == QINFO_INTERNAL_POOLSIZE || info->sync != NULL ||
+      info->parent != NULL || info->owner != NULL ||
+      info->arena.allocator.alloc != NULL || info->profile != NULL ||
+      !QInfo_is_Success(Clear(info))) {
+    return QInfo_free(info);
+  }
+  Thread_pool.objects[Thread_pool.count++] = info;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_pool_drain(void) {
+  while (Thread_pool.count > 0) {
+    QInfo_free(Thread_pool.objects[--Thread_pool.count]);
+  }
+  return QINFO_SUCCESS;
+}
+
+static int Compact(QInfo info) {
+  // The new arena takes over the counters of the object.
+  QInfo_arena_t arena = info->arena;
+  Arena_init(&arena, &info->arena.allocator);
+  if (info->arena.live > 0) {
+    // Every array may need padding to its alignment.
+    const int err = Arena_reserve(
+        &arena, info->arena.live +
+                    Space_owned_arrays(info) * QINFO_INTERNAL_ARRAYALIGN);
+    if (!QInfo_is_Success(err)) {
+      return err;
+    }
+  }
+
+  // Strings shared with duplicates cannot move and stay where they are.
+  Space_copy_strings(info, &arena);
+  Arena_free_chunks(&info->arena.allocator, info->arena.chunks);
+  arena.shared = info->arena.shared;
+  info->arena = arena;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_compact(QInfo info) {
+  Write_lock(info);
+  const int err = Compact(info);
+  Write_unlock(info);
+  return err;
+}
+
+static int Get_arena_usage(QInfo info, size_t *live, size_t *wasted) {
+  if (live != NULL) {
+    *live = info->arena.live;
+  }
+  if (wasted != NULL) {
+    *wasted = info->arena.wasted;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_arena_usage(QInfo info, size_t *live, size_t *wasted) {
+  Read_lock(info);
+  const int err = Get_arena_usage(info, live, wasted);
+  Read_unlock(info);
+  return err;
+}
+
+static int Get_stats(QInfo info, QInfo_stats *stats) {
+  memset(stats, 0, sizeof(QInfo_stats));
+  stats->live_bytes = Footprint(info, &stats->shared_bytes);
+  stats->peak_bytes = stats->live_bytes;
+#ifdef QINFO_ENABLE_STATS
+  QInfo_counters_t *counters = &info->arena.counters;
+  stats->instrumented = 1;
+  stats->lookups =
+      atomic_load_explicit(&counters->lookups, memory_order_relaxed);
+  stats->hits = atomic_load_explicit(&counters->hits, memory_order_relaxed);
+  stats->misses = stats->lookups - stats->hits;
+  stats->probes = atomic_load_explicit(&counters->probes, memory_order_relaxed);
+  stats->max_probe =
+      atomic_load_explicit(&counters->max_probe, memory_order_relaxed);
+  stats->growths = counters->growths;
+  stats->allocations = counters->allocations;
+  if (counters->peak_bytes > stats->peak_bytes) {
+    stats->peak_bytes = counters->peak_bytes;
+  }
+#endif
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_stats(QInfo info, QInfo_stats *stats) {
+  Read_lock(info);
+  const int err = Get_stats(info, stats);
+  Read_unlock(info);
+  return err;
+}
+
+static int Profile(QInfo info, const int enable) {
+  if (!enable) {
+    Mem_free(&info->arena.allocator, info->profile);
+    info->profile = NULL;
+    return QINFO_SUCCESS;
+  }
+  if (info->profile != NULL) {
+    return QINFO_SUCCESS;
+  }
+  atomic_ullong *profile = (atomic_ullong *)Mem_alloc(
+      &info->arena, sizeof(atomic_ullong) * (unsigned long)info->size);
+  if (profile == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  for (int i = 0; i < info->size; ++i) {
+    atomic_init(&profile[i], 0);
+  }
+  info->profile = profile;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_profile(QInfo info, const int enable) {
+  Write_lock(info);
+  const int err = Profile(info, enable);
+  Write_unlock(info);
+  return err;
+}
+
+/**
+ * @brief Internal structure for an entry of the hot-key profile.
+ */
+typedef struct QInfo_hot_key_d {
+  uint64_t count;    /**< The number of lookups of the key. */
+  QInfo_index index; /**< The slot of the key. */
+} QInfo_hot_key_t;
+
+/**
+ * @brief Orders hot keys by descending number of lookups, then by slot.
+ */
+static int Hot_key_compare(const void *lhs, const void *rhs) {
+  const QInfo_hot_key_t *a = (const QInfo_hot_key_t *)lhs;
+  const QInfo_hot_key_t *b = (const QInfo_hot_key_t *)rhs;
+  if (a->count != b->count) {
+    return a->count > b->count ? -1 : 1;
+  }
+  return (a->index > b->index) - (a->index < b->index);
+}
+
+static int Get_hot_keys(QInfo info, const size_t capacity,
+                        QInfo_index *indices, uint64_t *counts,
+                        size_t *count) {
+  *count = 0;
+  if (info->profile == NULL || info->num_occupied == 0) {
+    return QINFO_SUCCESS;
+  }
+
+  QInfo_hot_key_t *keys = (QInfo_hot_key_t *)malloc(
+      sizeof(QInfo_hot_key_t) * (unsigned long)info->num_occupied);
+  if (keys == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  size_t num_keys = 0;
+  for (int i = Next_occupied(info, 0); i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    const uint64_t hits =
+        atomic_load_explicit(&info->profile[i], memory_order_relaxed);
+    if (hits > 0) {
+      keys[num_keys].count = hits;
+      keys[num_keys].index = i;
+      num_keys++;
+    }
+  }
+  qsort(keys, num_keys, sizeof(QInfo_hot_key_t), Hot_key_compare);
+
+  *count = num_keys < capacity ? num_keys : capacity;
+  for (size_t i = 0; i < *count; ++i) {
+    indices[i] = keys[i].index;
+    if (counts != NULL) {
+      counts[i] = keys[i].count;
+    }
+  }
+  free(keys);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_hot_keys(QInfo info, const size_t capacity, QInfo_index *indices,
+                       uint64_t *counts, size_t *count) {
+  Read_lock(info);
+  const int err = Get_hot_keys(info, capacity, indices, counts, count);
+  Read_unlock(info);
+  return err;
+}
+
+/**
+ * @brief Internal structure for a bucket of a probe run being reordered.
+ */
+typedef struct QInfo_run_entry_d {
+  uint64_t count;             /**< The number of lookups of the key. */
+  uint32_t home;              /**< The home bucket relative to the run. */
+  QInfo_hash_bucket_t bucket; /**< The bucket. */
+} QInfo_run_entry_t;
+
+/**
+ * @brief Determines whether the run entry @p a should be placed before @p b.
+ */
+static inline int Run_entry_before(const QInfo_run_entry_t *a,
+                                   const QInfo_run_entry_t *b) {
+  return a->count != b->count ? a->count > b->count : a->home < b->home;
+}
+
+static int Run_entry_compare(const void *lhs, const void *rhs) {
+  const QInfo_run_entry_t *a = (const QInfo_run_entry_t *)lhs;
+  const QInfo_run_entry_t *b = (const QInfo_run_entry_t *)rhs;
+  return (a->home > b->home) - (a->home < b->home);
+}
+
+/**
+ * @brief Rewrites the run of @p length occupied buckets starting at
+ * @p first such that frequently looked up keys come first.
+ * @details Every position of the run is filled with the hottest remaining
+ * entry whose home bucket lies at or before it, which keeps every key
+ * reachable from its home bucket. @p entries and @p heap provide scratch
+ * space for @p length entries.
+ */
+static void Optimize_run(QInfo info, const uint32_t first,
+                         const uint32_t length, QInfo_run_entry_t *entries,
+                         uint32_t *heap) {
+  QInfo_hash_bucket_t *buckets = info->index->buckets;
+  const uint32_t mask = info->index->num_buckets - 1;
+  for (uint32_t i = 0; i < length; ++i) {
+    const QInfo_hash_bucket_t *bucket = &buckets[(first + i) & mask];
+    entries[i].bucket = *bucket;
+    entries[i].home =
+        ((uint32_t)Space_slot(info, bucket->index)->hash - first) & mask;
+    entries[i].count = atomic_load_explicit(&info->profile[bucket->index],
+                                            memory_order_relaxed);
+  }
+  qsort(entries, length, sizeof(QInfo_run_entry_t), Run_entry_compare);
+
+  // Binary max-heap of the entries that may be placed at the current
+  // position.
+  uint32_t size = 0;
+  uint32_t next = 0;
+  for (uint32_t pos = 0; pos < length; ++pos) {
+    for (; next < length && entries[next].home <= pos; ++next) {
+      uint32_t child = size++;
+      while (child > 0) {
+        const uint32_t parent = (child - 1) / 2;
+        if (!Run_entry_before(&entries[next], &entries[heap[parent]])) {
+          break;
+        }
+        heap[child] = heap[parent];
+        child = parent;
+      }
+      heap[child] = next;
+    }
+
+    buckets[(first + pos) & mask] = entries[heap[0]].bucket;
+    const uint32_t last = heap[--size];
+    uint32_t parent = 0;
+    for (uint32_t child = 1; child < size; child = 2 * parent + 1) {
+      if (child + 1 < size &&
+          Run_entry_before(&entries[heap[child + 1]], &entries[heap[child]])) {
+        child++;
+      }
+      if (!Run_entry_before(&entries[heap[child]], &entries[last])) {
+        break;
+      }
+      heap[parent] = heap[child];
+      parent = child;
+    }
+    heap[parent] = last;
+  }
+}
+
+static int Optimize(QInfo info) {
+  if (info->profile == NULL || info->num_occupied == 0) {
+    return QINFO_SUCCESS;
+  }
+  if (!QInfo_is_Success(Index_own(info))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  QInfo_run_entry_t *entries = (QInfo_run_entry_t *)malloc(
+      sizeof(QInfo_run_entry_t) * (unsigned long)info->num_occupied);
+  uint32_t *heap =
+      (uint32_t *)malloc(sizeof(uint32_t) * (unsigned long)info->num_occupied);
+  if (entries == NULL || heap == NULL) {
+    free(entries);
+    free(heap);
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  // The load factor is at most 3/4, so there is an empty bucket to start
+  // from, and no run wraps around onto itself.
+  const QInfo_hash_bucket_t *buckets = info->index->buckets;
+  const uint32_t num_buckets = info->index->num_buckets;
+  const uint32_t mask = num_buckets - 1;
+  uint32_t start = 0;
+  while (buckets[start].index != QINFO_INTERNAL_EMPTYBUCKET) {
+    start++;
+  }
+  uint32_t length = 0;
+  for (uint32_t i = 1; i <= num_buckets; ++i) {
+    const uint32_t pos = (start + i) & mask;
+    if (buckets[pos].index != QINFO_INTERNAL_EMPTYBUCKET) {
+      length++;
+      continue;
+    }
+    if (length > 1) {
+      Optimize_run(info, (pos - length) & mask, length, entries, heap);
+    }
+    length = 0;
+  }
+
+  free(entries);
+  free(heap);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_optimize(QInfo info) {
+  Write_lock(info);
+  const int err = Optimize(info);
+  Write_unlock(info);
+  return err;
+}
+
+static int Reserve(QInfo info, const int capacity) {
+  if (capacity < 0) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  return Space_reserve(info, capacity);
+}
+
+int QInfo_reserve(QInfo info, const int capacity) {
+  Write_lock(info);
+  const int err = Reserve(info, capacity);
+  Write_unlock(info);
+  return err;
+}
+
+int QInfo_key_make(const char *key, const size_t length, QInfo_key *handle) {
+  handle->data = key;
+  handle->length = length;
+  handle->hash = Hash_key(key, length);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_add(QInfo info, const char *key, const enum QINFO_TYPE type,
+              QInfo_index *index) {
+  QInfo_key handle;
+  Key_from_cstr(key, &handle);
+  return QInfo_add_key(info, &handle, type, index);
+}
+
+int QInfo_add_n(QInfo info, const char *key, const size_t length,
+                const enum QINFO_TYPE type, QInfo_index *index) {
+  QInfo_key handle;
+  QInfo_key_make(key, length, &handle);
+  return QInfo_add_key(info, &handle, type, index);
+}
+
+/**
+ * @brief Occupies an empty slot for the key @p name with hash @p hash.
+ * @details Space for the slot must have been reserved and the hash index must
+ * be owned by @p info. The value of the slot is left for the caller to set.
+ */
+static QInfo_value_space_t *Space_insert(QInfo info, const QInfo_string *name,
+                                         const uint64_t hash,
+                                         QInfo_index *index) {
+  int i = 0;
+  QInfo_value_space_t *slot = Space_take_slot(info, &i);
+  if (slot == NULL) {
+    return NULL;
+  }
+  slot->name = *name;
+  slot->hash = hash;
+  Set_occupied(info, i);
+  Index_insert(info, hash, i);
+  info->num_occupied++;
+  *index = i;
+  return slot;
+}
+
+static int Add_key(QInfo info, const QInfo_key *key, const enum QINFO_TYPE type,
+                   QInfo_index *index) {
+  if (key->length > UINT32_MAX) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+
+  // Check if key exists
+  if (Index_find(info, key) >= 0) {
+    return QINFO_ERROR_KEYEXISTS;
+  }
+
+  // Check if there is space
+  if (info->num_occupied == info->size) {
+    // Need more space
+    const int limit = Space_limit(info);
+    if (info->size >= limit) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    const int capacity = info->size > limit / QINFO_INTERNAL_SPACEGROWTHFACTOR
+                             ? limit
+                             : info->size * QINFO_INTERNAL_SPACEGROWTHFACTOR;
+    if (!QInfo_is_Success(Space_reserve(info, capacity))) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+  }
+
+  if (!QInfo_is_Success(Index_own(info))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  QInfo_string name;
+  if (!QInfo_is_Success(
+          String_assign(&info->arena, &name, key->data, key->length))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  // Take an empty slot and occupy it
+  QInfo_value_space_t *slot = Space_insert(info, &name, key->hash, index);
+  if (slot == NULL) {
+    String_release(&info->arena, &name);
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  slot->type = type;
+  if (type == QINFO_TYPE_STRING) {
+    String_unset(&slot->value.value_string);
+  } else if (Type_is_array(type)) {
+    slot->value.value_array.data = NULL;
+    slot->value.value_array.count = 0;
+  } else if (type == QINFO_TYPE_QINFO) {
+    slot->value.value_qinfo = NULL;
+  } else {
+    slot->value.value_i64 = 0;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_add_key(QInfo info, const QInfo_key *key, const enum QINFO_TYPE type,
+                  QInfo_index *index) {
+  Write_lock(info);
+  const int err = Add_key(info, key, type, index);
+  Write_unlock(info);
+  return err;
+}
+
+static inline int Check_index(QInfo info, const QInfo_index index) {
+  if (index < 0 || index >= info->size) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+
+  if (!Is_occupied(info, index)) {
+    return QINFO_WARN_NOKEY;
+  }
+
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Returns the layer of @p info that @p index refers to and stores the
+ * slot in that layer in @p slot.
+ * @details For objects without a parent and for indices whose layer does not
+ * exist, @p info and @p index are returned unchanged, so that Check_index
+ * rejects the latter.
+ */
+static QInfo Layer_resolve(QInfo info, const QInfo_index index,
+                           QInfo_index *slot) {
+  *slot = index;
+  if (info->parent == NULL || index < 0) {
+    return info;
+  }
+  int layer = (int)((unsigned)index >> QINFO_INTERNAL_LAYERSHIFT);
+  if (layer > info->depth) {
+    return info;
+  }
+  for (; layer > 0; --layer) {
+    info = info->parent;
+  }
+  *slot = index & (QINFO_INTERNAL_LAYERSLOTS - 1);
+  return info;
+}
+
+static int Remove(QInfo info, const QInfo_index index) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (!QInfo_is_Success(Index_own(info))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  QInfo_value_space_t *slot = Space_slot_mut(info, index);
+  if (slot == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  Index_erase(info, slot->hash, index);
+  Profile_reset(info, index);
+
+  String_release(&info->arena, &slot->name);
+  if (slot->type == QINFO_TYPE_STRING) {
+    String_release(&info->arena, &slot->value.value_string);
+  } else if (Type_is_array(slot->type)) {
+    Array_release(&info->arena, &slot->value.value_array, slot->type);
+  } else if (slot->type == QINFO_TYPE_QINFO) {
+    Child_release(info, slot->value.value_qinfo);
+  }
+
+  Clear_occupied(info, index);
+  String_unset(&slot->name);
+  slot->type = QINFO_TYPE_INT32;
+  slot->value.value_i32 = info->free_head;
+  info->free_head = index;
+  info->num_occupied--;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_remove(QInfo info, const QInfo_index index) {
+  Write_lock(info);
+  const int err = Remove(info, index);
+  Write_unlock(info);
+  return err;
+}
+
+int QInfo_query(QInfo info, const char *key, QInfo_index *index) {
+  QInfo_key handle;
+  Key_from_cstr(key, &handle);
+  return QInfo_query_key(info, &handle, index);
+}
+
+int QInfo_query_n(QInfo info, const char *key, const size_t length,
+                  QInfo_index *index) {
+  QInfo_key handle;
+  QInfo_key_make(key, length, &handle);
+  return QInfo_query_key(info, &handle, index);
+}
+
+static int Query_key(QInfo info, const QInfo_key *key, QInfo_index *index) {
+  const int slot = Index_find(info, key);
+  if (slot < 0) {
+    return QINFO_WARN_NOKEY;
+  }
+  Profile_hit(info, slot);
+  *index = slot;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Looks up @p key in the ancestors of @p info.
+ * @details The ancestors are locked one at a time, so that no two locks are
+ * ever held at once.
+ */
+static int Query_ancestors(QInfo info, const QInfo_key *key,
+                           QInfo_index *index) {
+  int layer = 1;
+  for (QInfo ancestor = info->parent; ancestor != NULL;
+       ancestor = ancestor->parent, ++layer) {
+    Read_lock(ancestor);
+    const int slot = Index_find(ancestor, key);
+    Read_unlock(ancestor);
+    if (slot >= QINFO_INTERNAL_LAYERSLOTS) {
+      return QINFO_ERROR_OUTOFBOUNDS;
+    }
+    if (slot >= 0) {
+      *index = (QInfo_index)((unsigned)layer << QINFO_INTERNAL_LAYERSHIFT) |
+               slot;
+      return QINFO_SUCCESS;
+    }
+  }
+  return QINFO_WARN_NOKEY;
+}
+
+int QInfo_query_key(QInfo info, const QInfo_key *key, QInfo_index *index) {
+  Read_lock(info);
+  int err = Query_key(info, key, index);
+  Read_unlock(info);
+  if (err == QINFO_WARN_NOKEY && info->parent != NULL) {
+    err = Query_ancestors(info, key, index);
+  }
+  return err;
+}
+
+/**
+ * @brief Looks up @p key in @p *info and, unless it is the @p last key of a
+ * path, replaces @p *info by the object nested in the entry found.
+ */
+static int Query_step(QInfo *info, const QInfo_key *key, const int last,
+                      QInfo_index *index) {
+  int err = QInfo_query_key(*info, key, index);
+  if (!QInfo_is_Success(err) || last) {
+    return err;
+  }
+  QInfo child = NULL;
+  err = QInfo_peek_child(*info, *index, &child);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  if (child == NULL) {
+    return QINFO_WARN_NOKEY;
+  }
+  *info = child;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_query_path(QInfo info, const size_t depth, const char *const *keys,
+                     QInfo *leaf, QInfo_index *index) {
+  if (depth == 0) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  QInfo_index found = 0;
+  for (size_t level = 0; level < depth; ++level) {
+    QInfo_key key;
+    Key_from_cstr(keys[level], &key);
+    const int err = Query_step(&info, &key, level + 1 == depth, &found);
+    if (!QInfo_is_Success(err)) {
+      return err;
+    }
+  }
+  *leaf = info;
+  *index = found;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_query_path_keys(QInfo info, const size_t depth,
+                          const QInfo_key *keys, QInfo *leaf,
+                          QInfo_index *index) {
+  if (depth == 0) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  QInfo_index found = 0;
+  for (size_t level = 0; level < depth; ++level) {
+    const int err =
+        Query_step(&info, &keys[level], level + 1 == depth, &found);
+    if (!QInfo_is_Success(err)) {
+      return err;
+    }
+  }
+  *leaf = info;
+  *index = found;
+  return QINFO_SUCCESS;
+}
+
+static int Get_key(QInfo info, const QInfo_index index, char **key) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  *key = Copy_string(String_data(&Space_slot(info, index)->name),
+                     String_length(&Space_slot(info, index)->name));
+  if (*key == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_key(QInfo info, const QInfo_index index, char **key) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Get_key(layer, slot, key);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Peek_key(QInfo info, const QInfo_index index, const char **key,
+                    size_t *length) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  *key = String_data(&Space_slot(info, index)->name);
+  if (length != NULL) {
+    *length = String_length(&Space_slot(info, index)->name);
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_peek_key(QInfo info, const QInfo_index index, const char **key,
+                   size_t *length) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Peek_key(layer, slot, key, length);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Get_type(QInfo info, const QInfo_index index,
+                    enum QINFO_TYPE *type) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  *type = Space_slot(info, index)->type;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_type(QInfo info, const QInfo_index index, enum QINFO_TYPE *type) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Get_type(layer, slot, type);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Get_val_i32(QInfo info, const QInfo_index index, int32_t *val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_INT32) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  *val = Space_slot(info, index)->value.value_i32;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_val_i32(QInfo info, const QInfo_index index, int32_t *val) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Get_val_i32(layer, slot, val);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Get_val_i64(QInfo info, const QInfo_index index, int64_t *val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_INT64) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  *val = Space_slot(info, index)->value.value_i64;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_val_i64(QInfo info, const QInfo_index index, int64_t *val) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Get_val_i64(layer, slot, val);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Get_val_f(QInfo info, const QInfo_index index, float *val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_FLOAT) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  *val = Space_slot(info, index)->value.value_float;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_val_f(QInfo info, const QInfo_index index, float *val) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Get_val_f(layer, slot, val);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Get_val_d(QInfo info, const QInfo_index index, double *val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_DOUBLE) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  *val = Space_slot(info, index)->value.value_double;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_val_d(QInfo info, const QInfo_index index, double *val) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Get_val_d(layer, slot, val);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Get_val_c(QInfo info, const QInfo_index index, char **val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_STRING) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  *val = strdup(String_data(&Space_slot(info, index)->value.value_string));
+  if (*val == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_val_c(QInfo info, const QInfo_index index, char **val) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Get_val_c(layer, slot, val);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Peek_val_c(QInfo info, const QInfo_index index, const char **val,
+                      size_t *length) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_STRING) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  *val = String_data(&Space_slot(info, index)->value.value_string);
+  if (length != NULL) {
+    *length = String_length(&Space_slot(info, index)->value.value_string);
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_peek_val_c(QInfo info, const QInfo_index index, const char **val,
+                     size_t *length) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Peek_val_c(layer, slot, val, length);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Set_i32(QInfo info, const QInfo_index index, int32_t val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_INT32) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  QInfo_value_space_t *slot = Space_slot_mut(info, index);
+  if (slot == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  slot->value.value_i32 = val;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_i32(QInfo info, const QInfo_index index, int32_t val) {
+  Write_lock(info);
+  const int err = Set_i32(info, index, val);
+  Write_unlock(info);
+  return err;
+}
+
+static int Set_i64(QInfo info, const QInfo_index index, int64_t val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_INT64) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  QInfo_value_space_t *slot = Space_slot_mut(info, index);
+  if (slot == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  slot->value.value_i64 = val;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_i64(QInfo info, const QInfo_index index, int64_t val) {
+  Write_lock(info);
+  const int err = Set_i64(info, index, val);
+  Write_unlock(info);
+  return err;
+}
+
+static int Set_f(QInfo info, const QInfo_index index, float val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_FLOAT) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  QInfo_value_space_t *slot = Space_slot_mut(info, index);
+  if (slot == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  slot->value.value_float = val;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_f(QInfo info, const QInfo_index index, float val) {
+  Write_lock(info);
+  const int err = Set_f(info, index, val);
+  Write_unlock(info);
+  return err;
+}
+
+static int Set_d(QInfo info, const QInfo_index index, double val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_DOUBLE) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  QInfo_value_space_t *slot = Space_slot_mut(info, index);
+  if (slot == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  slot->value.value_double = val;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_d(QInfo info, const QInfo_index index, double val) {
+  Write_lock(info);
+  const int err = Set_d(info, index, val);
+  Write_unlock(info);
+  return err;
+}
+
+static int Set_c(QInfo info, const QInfo_index index, const char *val) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_STRING) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+
+  const size_t length = strlen(val);
+  if (length > UINT32_MAX) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  QInfo_value_space_t *slot = Space_slot_mut(info, index);
+  if (slot == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  QInfo_string *str = &slot->value.value_string;
+
+  // Short values are stored inline, which cannot fail.
+  if (length < QINFO_INTERNAL_INLINESTRING) {
+    String_release(&info->arena, str);
+    return String_assign(&info->arena, str, val, length);
+  }
+
+  // Overwrite in place if the new value fits into the same arena block.
+  if (!String_is_inline(str) && str->heap.data != NULL &&
+      Arena_block_size(str->heap.length) == Arena_block_size(length) &&
+      Arena_owns(&info->arena, str->heap.data)) {
+    memcpy(str->heap.data, val, length);
+    str->heap.data[length] = '\0';
+    str->heap.length = (uint32_t)length;
+    return QINFO_SUCCESS;
+  }
+
+  QInfo_string copy;
+  if (!QInfo_is_Success(String_assign(&info->arena, &copy, val, length))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  String_release(&info->arena, str);
+  *str = copy;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_c(QInfo info, const QInfo_index index, const char *val) {
+  Write_lock(info);
+  const int err = Set_c(info, index, val);
+  Write_unlock(info);
+  return err;
+}
+
+static int Peek_array(QInfo info, const QInfo_index index,
+                      const enum QINFO_TYPE type, const void **vals,
+                      size_t *count) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  const QInfo_value_space_t *slot = Space_slot(info, index);
+  if (slot->type != type) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+  *vals = slot->value.value_array.data;
+  *count = slot->value.value_array.count;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_peek_array_i32(QInfo info, const QInfo_index index,
+                         const int32_t **vals, size_t *count) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  const void *data = NULL;
+  Read_lock(layer);
+  const int err =
+      Peek_array(layer, slot, QINFO_TYPE_INT32_ARRAY, &data, count);
+  Read_unlock(layer);
+  if (QInfo_is_Success(err)) {
+    *vals = (const int32_t *)data;
+  }
+  return err;
+}
+
+int QInfo_peek_array_i64(QInfo info, const QInfo_index index,
+                         const int64_t **vals, size_t *count) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  const void *data = NULL;
+  Read_lock(layer);
+  const int err =
+      Peek_array(layer, slot, QINFO_TYPE_INT64_ARRAY, &data, count);
+  Read_unlock(layer);
+  if (QInfo_is_Success(err)) {
+    *vals = (const int64_t *)data;
+  }
+  return err;
+}
+
+int QInfo_peek_array_f(QInfo info, const QInfo_index index,
+                       const float **vals, size_t *count) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  const void *data = NULL;
+  Read_lock(layer);
+  const int err =
+      Peek_array(layer, slot, QINFO_TYPE_FLOAT_ARRAY, &data, count);
+  Read_unlock(layer);
+  if (QInfo_is_Success(err)) {
+    *vals = (const float *)data;
+  }
+  return err;
+}
+
+int QInfo_peek_array_d(QInfo info, const QInfo_index index,
+                       const double **vals, size_t *count) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  const void *data = NULL;
+  Read_lock(layer);
+  const int err =
+      Peek_array(layer, slot, QINFO_TYPE_DOUBLE_ARRAY, &data, count);
+  Read_unlock(layer);
+  if (QInfo_is_Success(err)) {
+    *vals = (const double *)data;
+  }
+  return err;
+}
+
+static int Set_array(QInfo info, const QInfo_index index,
+                     const enum QINFO_TYPE type, const void *vals,
+                     const size_t count) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != type) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+  if (count > UINT32_MAX) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  const size_t element_size = Array_element_size(type);
+  const size_t bytes = count * element_size;
+  QInfo_value_space_t *slot = Space_slot_mut(info, index);
+  if (slot == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  QInfo_array *array = &slot->value.value_array;
+
+  // Overwrite in place if the new elements fit into the same arena block. The
+  // elements may be a view of the current ones.
+  if (array->data != NULL && count > 0 &&
+      Arena_block_size((size_t)array->count * element_size) ==
+          Arena_block_size(bytes) &&
+      Arena_owns(&info->arena, (const char *)array->data)) {
+    memmove(array->data, vals, bytes);
+    array->count = (uint32_t)count;
+    return QINFO_SUCCESS;
+  }
+
+  void *data = NULL;
+  if (count > 0) {
+    data = Arena_alloc_array(&info->arena, bytes);
+    if (data == NULL) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    memcpy(data, vals, bytes);
+  }
+  Array_release(&info->arena, array, type);
+  array->data = data;
+  array->count = (uint32_t)count;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_array_i32(QInfo info, const QInfo_index index,
+                        const int32_t *vals, const size_t count) {
+  Write_lock(info);
+  const int err = Set_array(info, index, QINFO_TYPE_INT32_ARRAY, vals, count);
+  Write_unlock(info);
+  return err;
+}
+
+int QInfo_set_array_i64(QInfo info, const QInfo_index index,
+                        const int64_t *vals, const size_t count) {
+  Write_lock(info);
+  const int err = Set_array(info, index, QINFO_TYPE_INT64_ARRAY, vals, count);
+  Write_unlock(info);
+  return err;
+}
+
+int QInfo_set_array_f(QInfo info, const QInfo_index index,
+                      const float *vals, const size_t count) {
+  Write_lock(info);
+  const int err = Set_array(info, index, QINFO_TYPE_FLOAT_ARRAY, vals, count);
+  Write_unlock(info);
+  return err;
+}
+
+int QInfo_set_array_d(QInfo info, const QInfo_index index,
+                      const double *vals, const size_t count) {
+  Write_lock(info);
+  const int err = Set_array(info, index, QINFO_TYPE_DOUBLE_ARRAY, vals, count);
+  Write_unlock(info);
+  return err;
+}
+
+int QInfo_peek_blob(QInfo info, const QInfo_index index, const void **data,
+                    size_t *size) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Peek_array(layer, slot, QINFO_TYPE_BLOB, data, size);
+  Read_unlock(layer);
+  return err;
+}
+
+int QInfo_set_blob(QInfo info, const QInfo_index index, const void *data,
+                   const size_t size) {
+  Write_lock(info);
+  const int err = Set_array(info, index, QINFO_TYPE_BLOB, data, size);
+  Write_unlock(info);
+  return err;
+}
+
+static int Peek_child(QInfo info, const QInfo_index index, QInfo *child) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  const QInfo_value_space_t *slot = Space_slot(info, index);
+  if (slot->type != QINFO_TYPE_QINFO) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+  *child = slot->value.value_qinfo;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_peek_child(QInfo info, const QInfo_index index, QInfo *child) {
+  QInfo_index slot = 0;
+  QInfo layer = Layer_resolve(info, index, &slot);
+  Read_lock(layer);
+  const int err = Peek_child(layer, slot, child);
+  Read_unlock(layer);
+  return err;
+}
+
+static int Set_child(QInfo info, const QInfo_index index, QInfo child) {
+  const int err = Check_index(info, index);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  if (Space_slot(info, index)->type != QINFO_TYPE_QINFO) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+  // Nesting must form a tree, so that every object is freed exactly once.
+  if (child != NULL) {
+    if (child->owner != NULL || child->parent != NULL) {
+      return QINFO_ERROR_INVALIDTYPE;
+    }
+    for (QInfo owner = info; owner != NULL; owner = owner->owner) {
+      if (owner == child) {
+        return QINFO_ERROR_INVALIDTYPE;
+      }
+    }
+  }
+  QInfo_value_space_t *slot = Space_slot_mut(info, index);
+  if (slot == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  Child_release(info, slot->value.value_qinfo);
+  slot->value.value_qinfo = child;
+  if (child != NULL) {
+    child->owner = info;
+    info->num_children++;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_child(QInfo info, const QInfo_index index, QInfo child) {
+  Write_lock(info);
+  const int err = Set_child(info, index, child);
+  Write_unlock(info);
+  return err;
+}
+
+/**
+ * @brief Validates that all @p count entries at @p indices exist and hold
+ * values of type @p type.
+ * @return QINFO_SUCCESS if all entries are valid, the status of the first
+ * invalid entry otherwise.
+ */
+static int Check_many(QInfo info, const size_t count,
+                      const QInfo_index *indices, const enum QINFO_TYPE type) {
+  for (size_t i = 0; i < count; ++i) {
+    const int err = Check_index(info, indices[i]);
+    if (!QInfo_is_Success(err)) {
+      return err;
+    }
+    if (Space_slot(info, indices[i])->type != type) {
+      return QINFO_ERROR_INVALIDTYPE;
+    }
+  }
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Validates @p indices like Check_many for an object with a parent.
+ */
+static int Check_many_layered(QInfo info, const size_t count,
+                              const QInfo_index *indices,
+                              const enum QINFO_TYPE type) {
+  for (size_t i = 0; i < count; ++i) {
+    enum QINFO_TYPE actual = QINFO_TYPE_INT32;
+    const int err = QInfo_get_type(info, indices[i], &actual);
+    if (!QInfo_is_Success(err)) {
+      return err;
+    }
+    if (actual != type) {
+      return QINFO_ERROR_INVALIDTYPE;
+    }
+  }
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Makes the pages of all @p count entries at @p indices private to
+ * @p info.
+ * @details Lets batch setters copy shared pages before any value is written,
+ * so that running out of memory leaves all values unchanged.
+ */
+static int Space_own_slots(QInfo info, const size_t count,
+                           const QInfo_index *indices) {
+  for (size_t i = 0; i < count; ++i) {
+    if (Space_slot_mut(info, indices[i]) == NULL) {
+      return QINFO_ERROR_OUTOFMEM;
+    }
+  }
+  return QINFO_SUCCESS;
+}
+
+static int Add_many(QInfo info, const size_t count, const char *const *keys,
+                    const enum QINFO_TYPE *types, QInfo_index *indices) {
+  if (count > (size_t)(INT_MAX - info->num_occupied)) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  const int err = Space_reserve(info, info->num_occupied + (int)count);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    QInfo_key key;
+    Key_from_cstr(keys[i], &key);
+    const int err_add = Add_key(info, &key, types[i], &indices[i]);
+    if (!QInfo_is_Success(err_add)) {
+      // Roll back, so that either all or none of the entries are added.
+      while (i > 0) {
+        Remove(info, indices[--i]);
+      }
+      return err_add;
+    }
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_add_many(QInfo info, const size_t count, const char *const *keys,
+                   const enum QINFO_TYPE *types, QInfo_index *indices) {
+  Write_lock(info);
+  const int err = Add_many(info, count, keys, types, indices);
+  Write_unlock(info);
+  return err;
+}
+
+static int Query_many(QInfo info, const size_t count, const char *const *keys,
+                      QInfo_index *indices) {
+  int err = QINFO_SUCCESS;
+  for (size_t i = 0; i < count; ++i) {
+    QInfo_key key;
+    Key_from_cstr(keys[i], &key);
+    indices[i] = Index_find(info, &key);
+    if (indices[i] < 0) {
+      err = QINFO_WARN_NOKEY;
+    } else {
+      Profile_hit(info, indices[i]);
+    }
+  }
+  return err;
+}
+
+int QInfo_query_many(QInfo info, const size_t count, const char *const *keys,
+                     QInfo_index *indices) {
+  Read_lock(info);
+  int err = Query_many(info, count, keys, indices);
+  Read_unlock(info);
+  if (err != QINFO_WARN_NOKEY || info->parent == NULL) {
+    return err;
+  }
+
+  err = QINFO_SUCCESS;
+  for (size_t i = 0; i < count; ++i) {
+    if (indices[i] < 0) {
+      QInfo_key key;
+      Key_from_cstr(keys[i], &key);
+      if (!QInfo_is_Success(Query_ancestors(info, &key, &indices[i]))) {
+        err = QINFO_WARN_NOKEY;
+      }
+    }
+  }
+  return err;
+}
+
+static int Get_many_i32(QInfo info, const size_t count,
+                        const QInfo_index *indices, int32_t *vals) {
+  const int err = Check_many(info, count, indices, QINFO_TYPE_INT32);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    vals[i] = Space_slot(info, indices[i])->value.value_i32;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_many_i32(QInfo info, const size_t count,
+                       const QInfo_index *indices, int32_t *vals) {
+  if (info->parent != NULL) {
+    int err = Check_many_layered(info, count, indices, QINFO_TYPE_INT32);
+    for (size_t i = 0; QInfo_is_Success(err) && i < count; ++i) {
+      err = QInfo_get_val_i32(info, indices[i], &vals[i]);
+    }
+    return err;
+  }
+  Read_lock(info);
+  const int err = Get_many_i32(info, count, indices, vals);
+  Read_unlock(info);
+  return err;
+}
+
+static int Get_many_i64(QInfo info, const size_t count,
+                        const QInfo_index *indices, int64_t *vals) {
+  const int err = Check_many(info, count, indices, QINFO_TYPE_INT64);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    vals[i] = Space_slot(info, indices[i])->value.value_i64;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_many_i64(QInfo info, const size_t count,
+                       const QInfo_index *indices, int64_t *vals) {
+  if (info->parent != NULL) {
+    int err = Check_many_layered(info, count, indices, QINFO_TYPE_INT64);
+    for (size_t i = 0; QInfo_is_Success(err) && i < count; ++i) {
+      err = QInfo_get_val_i64(info, indices[i], &vals[i]);
+    }
+    return err;
+  }
+  Read_lock(info);
+  const int err = Get_many_i64(info, count, indices, vals);
+  Read_unlock(info);
+  return err;
+}
+
+static int Get_many_f(QInfo info, const size_t count,
+                      const QInfo_index *indices, float *vals) {
+  const int err = Check_many(info, count, indices, QINFO_TYPE_FLOAT);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    vals[i] = Space_slot(info, indices[i])->value.value_float;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_many_f(QInfo info, const size_t count, const QInfo_index *indices,
+                     float *vals) {
+  if (info->parent != NULL) {
+    int err = Check_many_layered(info, count, indices, QINFO_TYPE_FLOAT);
+    for (size_t i = 0; QInfo_is_Success(err) && i < count; ++i) {
+      err = QInfo_get_val_f(info, indices[i], &vals[i]);
+    }
+    return err;
+  }
+  Read_lock(info);
+  const int err = Get_many_f(info, count, indices, vals);
+  Read_unlock(info);
+  return err;
+}
+
+static int Get_many_d(QInfo info, const size_t count,
+                      const QInfo_index *indices, double *vals) {
+  const int err = Check_many(info, count, indices, QINFO_TYPE_DOUBLE);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    vals[i] = Space_slot(info, indices[i])->value.value_double;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_get_many_d(QInfo info, const size_t count, const QInfo_index *indices,
+                     double *vals) {
+  if (info->parent != NULL) {
+    int err = Check_many_layered(info, count, indices, QINFO_TYPE_DOUBLE);
+    for (size_t i = 0; QInfo_is_Success(err) && i < count; ++i) {
+      err = QInfo_get_val_d(info, indices[i], &vals[i]);
+    }
+    return err;
+  }
+  Read_lock(info);
+  const int err = Get_many_d(info, count, indices, vals);
+  Read_unlock(info);
+  return err;
+}
+
+static int Peek_many_c(QInfo info, const size_t count,
+                       const QInfo_index *indices, const char **vals) {
+  const int err = Check_many(info, count, indices, QINFO_TYPE_STRING);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    vals[i] = String_data(&Space_slot(info, indices[i])->value.value_string);
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_peek_many_c(QInfo info, const size_t count,
+                      const QInfo_index *indices, const char **vals) {
+  if (info->parent != NULL) {
+    int err = Check_many_layered(info, count, indices, QINFO_TYPE_STRING);
+    for (size_t i = 0; QInfo_is_Success(err) && i < count; ++i) {
+      err = QInfo_peek_val_c(info, indices[i], &vals[i], NULL);
+    }
+    return err;
+  }
+  Read_lock(info);
+  const int err = Peek_many_c(info, count, indices, vals);
+  Read_unlock(info);
+  return err;
+}
+
+static int Set_many_i32(QInfo info, const size_t count,
+                        const QInfo_index *indices, const int32_t *vals) {
+  int err = Check_many(info, count, indices, QINFO_TYPE_INT32);
+  if (QInfo_is_Success(err)) {
+    err = Space_own_slots(info, count, indices);
+  }
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    Space_slot(info, indices[i])->value.value_i32 = vals[i];
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_many_i32(QInfo info, const size_t count,
+                       const QInfo_index *indices, const int32_t *vals) {
+  Write_lock(info);
+  const int err = Set_many_i32(info, count, indices, vals);
+  Write_unlock(info);
+  return err;
+}
+
+static int Set_many_i64(QInfo info, const size_t count,
+                        const QInfo_index *indices, const int64_t *vals) {
+  int err = Check_many(info, count, indices, QINFO_TYPE_INT64);
+  if (QInfo_is_Success(err)) {
+    err = Space_own_slots(info, count, indices);
+  }
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    Space_slot(info, indices[i])->value.value_i64 = vals[i];
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_many_i64(QInfo info, const size_t count,
+                       const QInfo_index *indices, const int64_t *vals) {
+  Write_lock(info);
+  const int err = Set_many_i64(info, count, indices, vals);
+  Write_unlock(info);
+  return err;
+}
+
+static int Set_many_f(QInfo info, const size_t count,
+                      const QInfo_index *indices, const float *vals) {
+  int err = Check_many(info, count, indices, QINFO_TYPE_FLOAT);
+  if (QInfo_is_Success(err)) {
+    err = Space_own_slots(info, count, indices);
+  }
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    Space_slot(info, indices[i])->value.value_float = vals[i];
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_many_f(QInfo info, const size_t count, const QInfo_index *indices,
+                     const float *vals) {
+  Write_lock(info);
+  const int err = Set_many_f(info, count, indices, vals);
+  Write_unlock(info);
+  return err;
+}
+
+static int Set_many_d(QInfo info, const size_t count,
+                      const QInfo_index *indices, const double *vals) {
+  int err = Check_many(info, count, indices, QINFO_TYPE_DOUBLE);
+  if (QInfo_is_Success(err)) {
+    err = Space_own_slots(info, count, indices);
+  }
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    Space_slot(info, indices[i])->value.value_double = vals[i];
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_many_d(QInfo info, const size_t count, const QInfo_index *indices,
+                     const double *vals) {
+  Write_lock(info);
+  const int err = Set_many_d(info, count, indices, vals);
+  Write_unlock(info);
+  return err;
+}
+
+static int Set_many_c(QInfo info, const size_t count,
+                      const QInfo_index *indices, const char *const *vals) {
+  const int err = Check_many(info, count, indices, QINFO_TYPE_STRING);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    const int err_set = Set_c(info, indices[i], vals[i]);
+    if (!QInfo_is_Success(err_set)) {
+      return err_set;
+    }
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_set_many_c(QInfo info, const size_t count, const QInfo_index *indices,
+                     const char *const *vals) {
+  Write_lock(info);
+  const int err = Set_many_c(info, count, indices, vals);
+  Write_unlock(info);
+  return err;
+}
+
+/**
+ * @brief Checks whether the slot @p slot of @p info may be written in place,
+ * i.e. neither the page table nor the page of the slot is shared with a
+ * duplicate.
+ */
+static inline int Slot_is_private(QInfo info, const int slot) {
+  return !Is_shared(&info->table->refcount) &&
+         !Is_shared(
+             &info->table->pages[(unsigned)slot / QINFO_INTERNAL_PAGESLOTS]
+                  ->refcount);
+}
+
+/**
+ * @brief Enters a read section on @p info for an atomic access to the value
+ * at @p index of type @p type.
+ * @details Atomic operations on a concurrent QInfo object only need to keep
+ * writers out, so that the slot neither moves nor disappears. If @p writable
+ * is set and the page of the slot is shared with a duplicate, the page is
+ * first copied under the write lock. On success, the caller must leave the
+ * read section with Read_unlock.
+ */
+static int Atomic_begin(QInfo info, const QInfo_index index,
+                        const enum QINFO_TYPE type, const int writable,
+                        QInfo_value **value) {
+  for (;;) {
+    Read_lock(info);
+    int err = Check_index(info, index);
+    if (QInfo_is_Success(err) && Space_slot(info, index)->type != type) {
+      err = QINFO_ERROR_INVALIDTYPE;
+    }
+    if (!QInfo_is_Success(err)) {
+      Read_unlock(info);
+      return err;
+    }
+    if (!writable || Slot_is_private(info, index)) {
+      *value = &Space_slot(info, index)->value;
+      return QINFO_SUCCESS;
+    }
+    Read_unlock(info);
+
+    // Copy the page, then retry, as the object may change in between.
+    Write_lock(info);
+    err = Check_index(info, index);
+    if (QInfo_is_Success(err) && Space_slot_mut(info, index) == NULL) {
+      err = QINFO_ERROR_OUTOFMEM;
+    }
+    Write_unlock(info);
+    if (!QInfo_is_Success(err)) {
+      return err;
+    }
+  }
+}
+
+int QInfo_load_i32(QInfo info, const QInfo_index index, int32_t *val) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_INT32, 0, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  *val = atomic_load((_Atomic int32_t *)(void *)&value->value_i32);
+  Read_unlock(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_load_i64(QInfo info, const QInfo_index index, int64_t *val) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_INT64, 0, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  *val = atomic_load((_Atomic int64_t *)(void *)&value->value_i64);
+  Read_unlock(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_load_f(QInfo info, const QInfo_index index, float *val) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_FLOAT, 0, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  *val = atomic_load((_Atomic float *)(void *)&value->value_float);
+  Read_unlock(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_load_d(QInfo info, const QInfo_index index, double *val) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_DOUBLE, 0, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  *val = atomic_load((_Atomic double *)(void *)&value->value_double);
+  Read_unlock(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_store_i32(QInfo info, const QInfo_index index, int32_t val) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_INT32, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  atomic_store((_Atomic int32_t *)(void *)&value->value_i32, val);
+  Read_unlock(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_store_i64(QInfo info, const QInfo_index index, int64_t val) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_INT64, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  atomic_store((_Atomic int64_t *)(void *)&value->value_i64, val);
+  Read_unlock(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_store_f(QInfo info, const QInfo_index index, float val) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_FLOAT, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  atomic_store((_Atomic float *)(void *)&value->value_float, val);
+  Read_unlock(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_store_d(QInfo info, const QInfo_index index, double val) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_DOUBLE, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  atomic_store((_Atomic double *)(void *)&value->value_double, val);
+  Read_unlock(info);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_fetch_add_i32(QInfo info, const QInfo_index index, int32_t delta,
+                        int32_t *previous) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_INT32, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  const int32_t old =
+      atomic_fetch_add((_Atomic int32_t *)(void *)&value->value_i32, delta);
+  Read_unlock(info);
+  if (previous != NULL) {
+    *previous = old;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_fetch_add_i64(QInfo info, const QInfo_index index, int64_t delta,
+                        int64_t *previous) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_INT64, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  const int64_t old =
+      atomic_fetch_add((_Atomic int64_t *)(void *)&value->value_i64, delta);
+  Read_unlock(info);
+  if (previous != NULL) {
+    *previous = old;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_compare_exchange_i32(QInfo info, const QInfo_index index,
+                               int32_t *expected, int32_t desired) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_INT32, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  const int exchanged = atomic_compare_exchange_strong(
+      (_Atomic int32_t *)(void *)&value->value_i32, expected, desired);
+  Read_unlock(info);
+  return exchanged ? QINFO_SUCCESS : QINFO_WARN_MISMATCH;
+}
+
+int QInfo_compare_exchange_i64(QInfo info, const QInfo_index index,
+                               int64_t *expected, int64_t desired) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_INT64, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  const int exchanged = atomic_compare_exchange_strong(
+      (_Atomic int64_t *)(void *)&value->value_i64, expected, desired);
+  Read_unlock(info);
+  return exchanged ? QINFO_SUCCESS : QINFO_WARN_MISMATCH;
+}
+
+int QInfo_compare_exchange_f(QInfo info, const QInfo_index index,
+                             float *expected, float desired) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_FLOAT, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  const int exchanged = atomic_compare_exchange_strong(
+      (_Atomic float *)(void *)&value->value_float, expected, desired);
+  Read_unlock(info);
+  return exchanged ? QINFO_SUCCESS : QINFO_WARN_MISMATCH;
+}
+
+int QInfo_compare_exchange_d(QInfo info, const QInfo_index index,
+                             double *expected, double desired) {
+  QInfo_value *value = NULL;
+  const int err = Atomic_begin(info, index, QINFO_TYPE_DOUBLE, 1, &value);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  const int exchanged = atomic_compare_exchange_strong(
+      (_Atomic double *)(void *)&value->value_double, expected, desired);
+  Read_unlock(info);
+  return exchanged ? QINFO_SUCCESS : QINFO_WARN_MISMATCH;
+}
+
+QInfo_iterator QInfo_begin(QInfo info) {
+  Read_lock(info);
+  const QInfo_iterator iter = Next_occupied(info, 0);
+  Read_unlock(info);
+  return iter;
+}
+
+QInfo_iterator QInfo_end(QInfo info) {
+  Read_lock(info);
+  const QInfo_iterator iter = info->size;
+  Read_unlock(info);
+  return iter;
+}
+
+void QInfo_next(QInfo info, QInfo_iterator *iter) {
+  Read_lock(info);
+  *iter = Next_occupied(info, *iter + 1);
+  Read_unlock(info);
+}
+
+int QInfo_empty(QInfo info) {
+  Read_lock(info);
+  const int empty = info->num_occupied == 0;
+  Read_unlock(info);
+  return empty;
+}
+
+/**
+ * @brief Finds the entry of @p info with the key of @p slot, a slot of another
+ * QInfo object, reusing its cached hash.
+ */
+static int Index_find_slot(QInfo info, const QInfo_value_space_t *slot) {
+  QInfo_key key;
+  key.data = String_data(&slot->name);
+  key.length = String_length(&slot->name);
+  key.hash = slot->hash;
+  return Index_find(info, &key);
+}
+
+static int Merge(QInfo dst, QInfo src, const enum QINFO_MERGE_POLICY policy) {
+  if (policy != QINFO_MERGE_OVERWRITE && policy != QINFO_MERGE_KEEP &&
+      policy != QINFO_MERGE_ERROR) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  if (src->num_occupied == 0) {
+    return QINFO_SUCCESS;
+  }
+  if (dst == src) {
+    // Every key conflicts with itself and keeps its value either way.
+    return policy == QINFO_MERGE_ERROR ? QINFO_ERROR_KEYEXISTS : QINFO_SUCCESS;
+  }
+
+  // Check for conflicts before anything is modified.
+  if (policy == QINFO_MERGE_ERROR) {
+    for (int i = Next_occupied(src, 0); i < src->size;
+         i = Next_occupied(src, i + 1)) {
+      if (Index_find_slot(dst, Space_slot(src, i)) >= 0) {
+        return QINFO_ERROR_KEYEXISTS;
+      }
+    }
+  }
+
+  if (src->num_occupied > INT_MAX - dst->num_occupied) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  int err = Space_reserve(dst, dst->num_occupied + src->num_occupied);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  if (!QInfo_is_Success(Index_own(dst))) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+
+  // Keys and string values are not copied. Instead, the strings of src are
+  // frozen into arena segments that dst references as well, like for a
+  // duplicate.
+  err = Arena_share(&src->arena);
+  if (QInfo_is_Success(err)) {
+    err = Arena_link(&dst->arena, src->arena.shared);
+  }
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  Stats_sample(src);
+
+  for (int i = Next_occupied(src, 0); i < src->size;
+       i = Next_occupied(src, i + 1)) {
+    const QInfo_value_space_t *from = Space_slot(src, i);
+    const int found =
+        policy == QINFO_MERGE_ERROR ? -1 : Index_find_slot(dst, from);
+    // Nested objects are duplicated before dst is modified, like the pages
+    // written below.
+    QInfo child = NULL;
+    if ((found < 0 || policy == QINFO_MERGE_OVERWRITE) &&
+        from->type == QINFO_TYPE_QINFO && from->value.value_qinfo != NULL) {
+      err = QInfo_duplicate(from->value.value_qinfo, &child);
+      if (!QInfo_is_Success(err)) {
+        return err;
+      }
+    }
+    QInfo_value_space_t *to = NULL;
+    if (found < 0) {
+      QInfo_index index = 0;
+      to = Space_insert(dst, &from->name, from->hash, &index);
+    } else if (policy == QINFO_MERGE_OVERWRITE) {
+      to = Space_slot_mut(dst, found);
+      if (to != NULL && to->type == QINFO_TYPE_STRING) {
+        String_release(&dst->arena, &to->value.value_string);
+      } else if (to != NULL && Type_is_array(to->type)) {
+        Array_release(&dst->arena, &to->value.value_array, to->type);
+      } else if (to != NULL && to->type == QINFO_TYPE_QINFO) {
+        Child_release(dst, to->value.value_qinfo);
+      }
+    } else {
+      continue;
+    }
+    if (to == NULL) {
+      if (child != NULL) {
+        QInfo_free(child);
+      }
+      return QINFO_ERROR_OUTOFMEM;
+    }
+    to->type = from->type;
+    to->value = from->value;
+    if (child != NULL) {
+      to->value.value_qinfo = child;
+      child->owner = dst;
+      dst->num_children++;
+    }
+  }
+  Stats_sample(dst);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_merge(QInfo dst, QInfo src, const enum QINFO_MERGE_POLICY policy) {
+  // Both objects are locked in the order of their addresses, so that merges
+  // in opposite directions cannot deadlock.
+  const int dst_first = (uintptr_t)dst < (uintptr_t)src;
+  QInfo first = dst_first ? dst : src;
+  QInfo second = dst_first ? src : dst;
+  Write_lock(first);
+  if (second != first) {
+    Write_lock(second);
+  }
+  const int err = Merge(dst, src, policy);
+  if (second != first) {
+    Write_unlock(second);
+  }
+  Write_unlock(first);
+  return err;
+}
+
+int QInfo_flatten(QInfo info, QInfo *flat) {
+  QInfo layers[QINFO_INTERNAL_MAXLAYERS + 1];
+  int num_layers = 0;
+  for (QInfo layer = info; layer != NULL; layer = layer->parent) {
+    layers[num_layers++] = layer;
+  }
+
+  // The root is duplicated in constant time. The overrides of the layers are
+  // then merged from the root towards info, so that deeper layers win.
+  QInfo out = NULL;
+  int err = QInfo_duplicate(layers[num_layers - 1], &out);
+  for (int i = num_layers - 2; QInfo_is_Success(err) && i >= 0; --i) {
+    err = QInfo_merge(out, layers[i], QINFO_MERGE_OVERWRITE);
+  }
+  if (!QInfo_is_Success(err)) {
+    if (out != NULL) {
+      QInfo_free(out);
+    }
+    return err;
+  }
+  *flat = out;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Maps @p hash uniformly onto [0, @p range) without a division.
+ */
+static inline uint32_t Fast_range(const uint32_t hash, const uint32_t range) {
+  return (uint32_t)(((uint64_t)hash * range) >> 32U);
+}
+
+static inline uint32_t Frozen_bucket(const uint64_t hash,
+                                     const uint32_t num_buckets) {
+  return Fast_range((uint32_t)hash, num_buckets);
+}
+
+/**
+ * @brief Computes the hash position of a key with hash @p hash for the pilot
+ * @p pilot of its bucket.
+ */
+static inline uint32_t Frozen_position(const uint64_t hash,
+                                       const uint32_t pilot,
+                                       const uint32_t num_positions) {
+  const uint64_t mixed =
+      Hash_finalize(hash ^ ((uint64_t)pilot * QINFO_INTERNAL_PILOTMULT));
+  return Fast_range((uint32_t)(mixed >> 32U), num_positions);
+}
+
+static inline const uint32_t *Frozen_pilots(QInfo_frozen frozen) {
+  return (const uint32_t *)(frozen + 1);
+}
+
+static inline const uint32_t *Frozen_remap(QInfo_frozen frozen) {
+  return Frozen_pilots(frozen) + frozen->num_buckets;
+}
+
+static inline const QInfo_frozen_entry_t *Frozen_entries(QInfo_frozen frozen) {
+  return (const QInfo_frozen_entry_t *)((const char *)frozen +
+                                        frozen->entries_offset);
+}
+
+static inline const char *Frozen_strings(QInfo_frozen frozen) {
+  return (const char *)frozen + frozen->strings_offset;
+}
+
+static inline int Is_taken(const uint64_t *taken, const uint32_t pos) {
+  return (int)((taken[pos / QINFO_INTERNAL_WORDBITS] >>
+                (pos % QINFO_INTERNAL_WORDBITS)) &
+               1U);
+}
+
+static inline void Flip_taken(uint64_t *taken, const uint32_t pos) {
+  taken[pos / QINFO_INTERNAL_WORDBITS] ^= 1ULL
+                                          << (pos % QINFO_INTERNAL_WORDBITS);
+}
+
+/**
+ * @brief Copies @p str into the string area @p strings at @p *used.
+ * @return The offset of the copy.
+ */
+static uint32_t Frozen_copy_string(char *strings, size_t *used,
+                                   const QInfo_string *str) {
+  const uint32_t offset = (uint32_t)*used;
+  const uint32_t length = String_length(str);
+  memcpy(strings + offset, String_data(str), length);
+  strings[offset + length] = '\0';
+  *used += (size_t)length + 1;
+  return offset;
+}
+
+/**
+ * @brief Finds the pilots of a minimal perfect hash over @p num_keys hashes.
+ * @details Hash-and-displace: keys are distributed over buckets, and the
+ * buckets are placed in order of decreasing size. For each bucket, the first
+ * pilot that maps all of its keys to free positions is chosen. Positions
+ * range over slightly more than @p num_keys values so that the last buckets
+ * still find free positions quickly; positions beyond @p num_keys are then
+ * remapped onto the positions below @p num_keys that remained free.
+ * @param[in] hashes The hashes of the keys.
+ * @param[in] num_keys The number of keys.
+ * @param[in,out] frozen The header of the frozen object. Its pilots and remap
+ * table are filled in.
+ * @param[out] positions The final position of each key.
+ * @param[in] scratch Scratch memory for 2 * @p num_keys + 2 * num_buckets + 1
+ * integers and the bitmap of taken positions.
+ * @return QINFO_SUCCESS on success, QINFO_ERROR_FATAL if two keys have the
+ * same hash.
+ */
+static int Frozen_build_hash(const uint64_t *hashes, const uint32_t num_keys,
+                             QInfo_frozen_impl_t *frozen, uint32_t *positions,
+                             uint32_t *scratch) {
+  const uint32_t num_buckets = frozen->num_buckets;
+  const uint32_t num_positions = frozen->num_positions;
+  uint32_t *pilots = (uint32_t *)(frozen + 1);
+  uint32_t *remap = pilots + num_buckets;
+
+  // Sort the keys by bucket.
+  uint32_t *start = scratch;                 // num_buckets + 1
+  uint32_t *keys = start + num_buckets + 1;  // num_keys
+  uint32_t *order = keys + num_keys;         // num_buckets
+  uint32_t *pos = order + num_buckets;       // num_keys + 1
+  uint64_t *taken = (uint64_t *)(void *)(pos + num_keys + 1);
+  memset(start, 0, sizeof(uint32_t) * ((size_t)num_buckets + 1));
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    start[Frozen_bucket(hashes[i], num_buckets) + 1]++;
+  }
+  uint32_t max_size = 0;
+  for (uint32_t b = 0; b < num_buckets; ++b) {
+    if (start[b + 1] > max_size) {
+      max_size = start[b + 1];
+    }
+    start[b + 1] += start[b];
+  }
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    keys[start[Frozen_bucket(hashes[i], num_buckets)]++] = i;
+  }
+  for (uint32_t b = num_buckets; b > 0; --b) {
+    start[b] = start[b - 1];
+  }
+  start[0] = 0;
+
+  // Order the buckets by decreasing size, counting the buckets of each size
+  // in pos.
+  memset(pos, 0, sizeof(uint32_t) * ((size_t)max_size + 1));
+  for (uint32_t b = 0; b < num_buckets; ++b) {
+    pos[max_size - (start[b + 1] - start[b])]++;
+  }
+  for (uint32_t s = 0, sum = 0; s <= max_size; ++s) {
+    const uint32_t count = pos[s];
+    pos[s] = sum;
+    sum += count;
+  }
+  for (uint32_t b = 0; b < num_buckets; ++b) {
+    order[pos[max_size - (start[b + 1] - start[b])]++] = b;
+  }
+
+  memset(taken, 0,
+         sizeof(uint64_t) * (size_t)Bitmap_words((int)num_positions + 1));
+  for (uint32_t o = 0; o < num_buckets; ++o) {
+    const uint32_t b = order[o];
+    const uint32_t first = start[b];
+    const uint32_t size = start[b + 1] - first;
+    if (size == 0) {
+      break;
+    }
+    for (uint32_t i = first; i < first + size; ++i) {
+      for (uint32_t j = first; j < i; ++j) {
+        if (hashes[keys[i]] == hashes[keys[j]]) {
+          return QINFO_ERROR_FATAL;
+        }
+      }
+    }
+
+    uint32_t pilot = 0;
+    for (;; ++pilot) {
+      uint32_t k = 0;
+      for (; k < size; ++k) {
+        const uint32_t p =
+            Frozen_position(hashes[keys[first + k]], pilot, num_positions);
+        if (Is_taken(taken, p)) {
+          break;
+        }
+        Flip_taken(taken, p);
+        pos[first + k] = p;
+      }
+      if (k == size) {
+        break;
+      }
+      while (k > 0) {
+        Flip_taken(taken, pos[first + --k]);
+      }
+    }
+    pilots[b] = pilot;
+  }
+
+  // Remap the positions beyond the number of keys onto the free positions.
+  uint32_t free_pos = 0;
+  for (uint32_t p = num_keys; p < num_positions; ++p) {
+    remap[p - num_keys] = 0;
+    if (Is_taken(taken, p)) {
+      while (Is_taken(taken, free_pos)) {
+        ++free_pos;
+      }
+      remap[p - num_keys] = free_pos++;
+    }
+  }
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    const uint32_t p = pos[i];
+    positions[keys[i]] = p < num_keys ? p : remap[p - num_keys];
+  }
+  return QINFO_SUCCESS;
+}
+
+static int Freeze(QInfo info, QInfo_frozen *frozen) {
+  const uint32_t num_keys = (uint32_t)info->num_occupied;
+  const uint32_t num_buckets = num_keys / QINFO_INTERNAL_FROZENBUCKETSIZE + 1;
+  // Leave about 6% of the positions free during placement.
+  const uint32_t num_positions =
+      num_keys == 0 ? 0 : num_keys + num_keys / 16 + 1;
+
+  size_t strings_size = 0;
+  for (int i = Next_occupied(info, 0); i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    const QInfo_value_space_t *slot = Space_slot(info, i);
+    if (Type_is_array(slot->type) || slot->type == QINFO_TYPE_QINFO) {
+      return QINFO_ERROR_INVALIDTYPE;
+    }
+    strings_size += (size_t)String_length(&slot->name) + 1;
+    if (slot->type == QINFO_TYPE_STRING &&
+        String_data(&slot->value.value_string) != NULL) {
+      strings_size += (size_t)String_length(&slot->value.value_string) + 1;
+    }
+  }
+  if (strings_size >= QINFO_INTERNAL_FROZENUNSET) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+
+  const size_t tables_end =
+      sizeof(QInfo_frozen_impl_t) +
+      sizeof(uint32_t) * ((size_t)num_buckets + (num_positions - num_keys));
+  const size_t entries_offset =
+      (tables_end + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+  const size_t strings_offset =
+      entries_offset + sizeof(QInfo_frozen_entry_t) * (size_t)num_keys;
+  const size_t size = strings_offset + strings_size;
+
+  QInfo_frozen_impl_t *out = (QInfo_frozen_impl_t *)malloc(size);
+  if (out == NULL) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  out->num_entries = num_keys;
+  out->num_buckets = num_buckets;
+  out->num_positions = num_positions;
+  out->flags = 0;
+  out->entries_offset = entries_offset;
+  out->strings_offset = strings_offset;
+  out->size = size;
+
+  // Scratch: hashes, slots and positions of the keys, followed by the scratch
+  // of Frozen_build_hash.
+  const size_t scratch_ints =
+      2 * (size_t)num_keys + 2 * (size_t)num_buckets + 2;
+  uint64_t *hashes = (uint64_t *)malloc(
+      sizeof(uint64_t) * ((size_t)num_keys +
+                          (size_t)Bitmap_words((int)num_positions + 1)) +
+      sizeof(uint32_t) * (2 * (size_t)num_keys + scratch_ints));
+  if (hashes == NULL) {
+    free(out);
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  uint32_t *slots = (uint32_t *)(void *)(hashes + num_keys);
+  uint32_t *positions = slots + num_keys;
+  uint32_t *scratch = positions + num_keys;
+
+  uint32_t k = 0;
+  for (int i = Next_occupied(info, 0); i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    hashes[k] = Space_slot(info, i)->hash;
+    slots[k++] = (uint32_t)i;
+  }
+
+  const int err = Frozen_build_hash(hashes, num_keys, out, positions, scratch);
+  if (!QInfo_is_Success(err)) {
+    free(hashes);
+    free(out);
+    return err;
+  }
+
+  QInfo_frozen_entry_t *entries =
+      (QInfo_frozen_entry_t *)(void *)((char *)out + entries_offset);
+  char *strings = (char *)out + strings_offset;
+  size_t used = 0;
+  for (k = 0; k < num_keys; ++k) {
+    const QInfo_value_space_t *slot = Space_slot(info, (int)slots[k]);
+    QInfo_frozen_entry_t *entry = &entries[positions[k]];
+    entry->hash = slot->hash;
+    entry->key_length = String_length(&slot->name);
+    entry->key_offset = Frozen_copy_string(strings, &used, &slot->name);
+    entry->type = (uint32_t)slot->type;
+    entry->reserved = 0;
+    if (slot->type == QINFO_TYPE_STRING) {
+      const QInfo_string *str = &slot->value.value_string;
+      entry->value.value_string.length = String_length(str);
+      entry->value.value_string.offset =
+          String_data(str) == NULL ? QINFO_INTERNAL_FROZENUNSET
+                                   : Frozen_copy_string(strings, &used, str);
+    } else {
+      entry->value.value_i64 = slot->value.value_i64;
+    }
+  }
+
+  free(hashes);
+  *frozen = out;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_freeze(QInfo info, QInfo_frozen *frozen) {
+  Read_lock(info);
+  const int err = Freeze(info, frozen);
+  Read_unlock(info);
+  return err;
+}
+
+/**
+ * @brief Unmaps the file mapped with File_map at @p base with @p size bytes.
+ */
+static void File_unmap(const void *base, const size_t size) {
+  if (size == 0) {
+    return;
+  }
+#if defined(_WIN32)
+  UnmapViewOfFile(base);
+#else
+  munmap((void *)base, size);
+#endif
+}
+
+int QInfo_frozen_free(QInfo_frozen frozen) {
+  if (frozen->flags & QINFO_INTERNAL_FROZENMAPPED) {
+    File_unmap((const char *)frozen - sizeof(QInfo_snapshot_header_t),
+                   sizeof(QInfo_snapshot_header_t) + frozen->size);
+    return QINFO_SUCCESS;
+  }
+  free((void *)frozen);
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_save(QInfo_frozen frozen, const char *path) {
+  QInfo_snapshot_header_t header;
+  memcpy(header.magic, QINFO_INTERNAL_SNAPSHOTMAGIC, sizeof(header.magic));
+  header.version = QINFO_INTERNAL_SNAPSHOTVERSION;
+  header.byte_order = QINFO_INTERNAL_BYTEORDER;
+  // The image in the file is only ever used through a mapping.
+  QInfo_frozen_impl_t image = *frozen;
+  image.flags = QINFO_INTERNAL_FROZENMAPPED;
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return QINFO_ERROR_IO;
+  }
+  const size_t rest = (size_t)frozen->size - sizeof(image);
+  int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+           fwrite(&image, sizeof(image), 1, file) == 1 &&
+           (rest == 0 || fwrite(frozen + 1, rest, 1, file) == 1);
+  ok = fclose(file) == 0 && ok;
+  return ok ? QINFO_SUCCESS : QINFO_ERROR_IO;
+}
+
+/**
+ * @brief Maps the file at @p path read-only and shared into memory.
+ * @details An empty file is not mapped; @p base is then set to NULL.
+ */
+static int File_map(const char *path, const char **base, size_t *size) {
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return QINFO_ERROR_IO;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    return QINFO_ERROR_IO;
+  }
+  if ((uint64_t)file_size.QuadPart > SIZE_MAX) {
+    CloseHandle(file);
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  if (file_size.QuadPart == 0) {
+    CloseHandle(file);
+    *base = NULL;
+    *size = 0;
+    return QINFO_SUCCESS;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    return QINFO_ERROR_IO;
+  }
+  const void *map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (map == NULL) {
+    return QINFO_ERROR_IO;
+  }
+  *size = (size_t)file_size.QuadPart;
+#else
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return QINFO_ERROR_IO;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return QINFO_ERROR_IO;
+  }
+  if ((uint64_t)st.st_size > SIZE_MAX) {
+    close(fd);
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    *base = NULL;
+    *size = 0;
+    return QINFO_SUCCESS;
+  }
+  const void *map =
+      mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return QINFO_ERROR_IO;
+  }
+  *size = (size_t)st.st_size;
+#endif
+  *base = (const char *)map;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Checks the header of the snapshot file mapped at @p base with
+ * @p size bytes and the layout of the frozen image it contains.
+ * @details Takes constant time. The entries and strings themselves are not
+ * validated.
+ */
+static int Snapshot_check(const char *base, const size_t size) {
+  if (size < sizeof(QInfo_snapshot_header_t) + sizeof(QInfo_frozen_impl_t)) {
+    return QINFO_ERROR_INVALIDFORMAT;
+  }
+  const QInfo_snapshot_header_t *header =
+      (const QInfo_snapshot_header_t *)(const void *)base;
+  if (memcmp(header->magic, QINFO_INTERNAL_SNAPSHOTMAGIC,
+             sizeof(header->magic)) != 0 ||
+      header->version != QINFO_INTERNAL_SNAPSHOTVERSION ||
+      header->byte_order != QINFO_INTERNAL_BYTEORDER) {
+    return QINFO_ERROR_INVALIDFORMAT;
+  }
+
+  const QInfo_frozen_impl_t *image =
+      (const QInfo_frozen_impl_t *)(const void *)(header + 1);
+  const uint64_t tables_end =
+      sizeof(QInfo_frozen_impl_t) +
+      sizeof(uint32_t) * ((uint64_t)image->num_buckets +
+                          image->num_positions - image->num_entries);
+  if (image->flags != QINFO_INTERNAL_FROZENMAPPED ||
+      image->size != size - sizeof(QInfo_snapshot_header_t) ||
+      image->num_buckets == 0 || image->num_positions < image->num_entries ||
+      image->entries_offset % sizeof(uint64_t) != 0 ||
+      image->entries_offset < tables_end ||
+      image->strings_offset != image->entries_offset +
+                                   sizeof(QInfo_frozen_entry_t) *
+                                       (uint64_t)image->num_entries ||
+      image->strings_offset > image->size) {
+    return QINFO_ERROR_INVALIDFORMAT;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_open_mapped(const char *path, QInfo_frozen *frozen) {
+  const char *base = NULL;
+  size_t size = 0;
+  int err = File_map(path, &base, &size);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  err = Snapshot_check(base, size);
+  if (!QInfo_is_Success(err)) {
+    File_unmap(base, size);
+    return err;
+  }
+  *frozen =
+      (QInfo_frozen)(const void *)(base + sizeof(QInfo_snapshot_header_t));
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_size(QInfo_frozen frozen) {
+  return (int)frozen->num_entries;
+}
+
+int QInfo_frozen_query(QInfo_frozen frozen, const char *key,
+                       QInfo_index *index) {
+  QInfo_key handle;
+  Key_from_cstr(key, &handle);
+  return QInfo_frozen_query_key(frozen, &handle, index);
+}
+
+int QInfo_frozen_query_n(QInfo_frozen frozen, const char *key,
+                         const size_t length, QInfo_index *index) {
+  QInfo_key handle;
+  QInfo_key_make(key, length, &handle);
+  return QInfo_frozen_query_key(frozen, &handle, index);
+}
+
+int QInfo_frozen_query_key(QInfo_frozen frozen, const QInfo_key *key,
+                           QInfo_index *index) {
+  if (frozen->num_entries == 0) {
+    return QINFO_WARN_NOKEY;
+  }
+
+  const uint32_t pilot =
+      Frozen_pilots(frozen)[Frozen_bucket(key->hash, frozen->num_buckets)];
+  uint32_t pos = Frozen_position(key->hash, pilot, frozen->num_positions);
+  if (pos >= frozen->num_entries) {
+    pos = Frozen_remap(frozen)[pos - frozen->num_entries];
+    // Guards against corrupted snapshot files.
+    if (pos >= frozen->num_entries) {
+      return QINFO_WARN_NOKEY;
+    }
+  }
+
+  // Every key maps to some entry, so a single comparison decides membership.
+  const QInfo_frozen_entry_t *entry = &Frozen_entries(frozen)[pos];
+  if (entry->hash != key->hash || entry->key_length != key->length ||
+      memcmp(Frozen_strings(frozen) + entry->key_offset, key->data,
+             key->length) != 0) {
+    return QINFO_WARN_NOKEY;
+  }
+  *index = (QInfo_index)pos;
+  return QINFO_SUCCESS;
+}
+
+/**
+ * @brief Gets the entry at @p index of @p frozen if it exists and holds a
+ * value of type @p type.
+ */
+static inline int Frozen_check(QInfo_frozen frozen, const QInfo_index index,
+                               const enum QINFO_TYPE type,
+                               const QInfo_frozen_entry_t **entry) {
+  if (index < 0 || (uint32_t)index >= frozen->num_entries) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  *entry = &Frozen_entries(frozen)[index];
+  if ((*entry)->type != (uint32_t)type) {
+    return QINFO_ERROR_INVALIDTYPE;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_peek_key(QInfo_frozen frozen, const QInfo_index index,
+                          const char **key, size_t *length) {
+  if (index < 0 || (uint32_t)index >= frozen->num_entries) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+
+  const QInfo_frozen_entry_t *entry = &Frozen_entries(frozen)[index];
+  *key = Frozen_strings(frozen) + entry->key_offset;
+  if (length != NULL) {
+    *length = entry->key_length;
+  }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_get_type(QInfo_frozen frozen, const QInfo_index index,
+                          enum QINFO_TYPE *type) {
+  if (index < 0 || (uint32_t)index >= frozen->num_entries) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+
+  *type = (enum QINFO_TYPE)Frozen_entries(frozen)[index].type;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_get_val_i32(QInfo_frozen frozen, const QInfo_index index,
+                             int32_t *val) {
+  const QInfo_frozen_entry_t *entry = NULL;
+  const int err = Frozen_check(frozen, index, QINFO_TYPE_INT32, &entry);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  *val = entry->value.value_i32;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_get_val_i64(QInfo_frozen frozen, const QInfo_index index,
+                             int64_t *val) {
+  const QInfo_frozen_entry_t *entry = NULL;
+  const int err = Frozen_check(frozen, index, QINFO_TYPE_INT64, &entry);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  *val = entry->value.value_i64;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_get_val_f(QInfo_frozen frozen, const QInfo_index index,
+                           float *val) {
+  const QInfo_frozen_entry_t *entry = NULL;
+  const int err = Frozen_check(frozen, index, QINFO_TYPE_FLOAT, &entry);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  *val = entry->value.value_float;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_get_val_d(QInfo_frozen frozen, const QInfo_index index,
+                           double *val) {
+  const QInfo_frozen_entry_t *entry = NULL;
+  const int err = Frozen_check(frozen, index, QINFO_TYPE_DOUBLE, &entry);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  *val = entry->value.value_double;
+  return QINFO_SUCCESS;
+}
+
+int QInfo_frozen_peek_val_c(QInfo_frozen frozen, const QInfo_index index,
+                            const char **val, size_t *length) {
+  const QInfo_frozen_entry_t *entry = NULL;
+  const int err = Frozen_check(frozen, index, QINFO_TYPE_STRING, &entry);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+
+  *val = entry->value.value_string.offset == QINFO_INTERNAL_FROZENUNSET
+             ? NULL
+             : Frozen_strings(frozen) + entry->value.value_string.offset;
+  if (length != NULL) {
+    *length = entry->value.value_string.length;
+  }
+  return QINFO_SUCCESS;
+}
+
+/*
+ * Serialization format, version 1. All integers are little-endian, floats and
+ * doubles are stored as their IEEE 754 bit patterns.
+ *
+ *   header: u32 magic, u16 version, u16 flags (0), u32 number of entries
+ *   entry:  u8 type, u32 key length, key bytes, value
+ *   value:  i32 | i64 | f32 | f64 | u32 length (UINT32_MAX if unset), bytes
+ *           | u32 count, elements
+ *
+ * Strings are not terminated. Array elements are encoded like single values
+ * of their type, blobs as raw bytes. A nested QInfo value is a complete
+ * serialized object prefixed by its length, which is UINT32_MAX if unset.
+ * Entries are written in iteration order.
+ */
+
+static inline void Store_u16(unsigned char *out, const uint32_t val) {
+  out[0] = (unsigned char)val;
+  out[1] = (unsigned char)(val >> 8U);
+}
+
+static inline void Store_u32(unsigned char *out, const uint32_t val) {
+  out[0] = (unsigned char)val;
+  out[1] = (unsigned char)(val >> 8U);
+  out[2] = (unsigned char)(val >> 16U);
+  out[3] = (unsigned char)(val >> 24U);
+}
+
+static inline void Store_u64(unsigned char *out, const uint64_t val) {
+  Store_u32(out, (uint32_t)val);
+  Store_u32(out + 4, (uint32_t)(val >> 32U));
+}
+
+static inline uint32_t Load_u16(const unsigned char *in) {
+  return (uint32_t)in[0] | (uint32_t)in[1] << 8U;
+}
+
+static inline uint32_t Load_u32(const unsigned char *in) {
+  return (uint32_t)in[0] | (uint32_t)in[1] << 8U | (uint32_t)in[2] << 16U |
+         (uint32_t)in[3] << 24U;
+}
+
+static inline uint64_t Load_u64(const unsigned char *in) {
+  return (uint64_t)Load_u32(in) | (uint64_t)Load_u32(in + 4) << 32U;
+}
+
+/**
+ * @brief Computes the size in bytes of the serialized value of @p slot.
+ */
+static inline size_t Serial_value_size(const QInfo_value_space_t *slot) {
+  switch (slot->type) {
+  case QINFO_TYPE_INT32:
+  case QINFO_TYPE_FLOAT:
+  case QINFO_TYPE_QINFO: // The nested object is sized by Serialize.
+    return 4;
+  case QINFO_TYPE_STRING:
+    return 4 + String_length(&slot->value.value_string);
+  case QINFO_TYPE_INT32_ARRAY:
+  case QINFO_TYPE_INT64_ARRAY:
+  case QINFO_TYPE_FLOAT_ARRAY:
+  case QINFO_TYPE_DOUBLE_ARRAY:
+  case QINFO_TYPE_BLOB:
+    return 4 + (size_t)slot->value.value_array.count *
+                   Array_element_size(slot->type);
+  default:
+    return 8;
+  }
+}
+
+/**
+ * @brief Writes the @p count elements of @p size bytes each at @p data to
+ * @p out in little-endian byte order.
+ * @return The position after the elements.
+ */
+static unsigned char *Serial_write_elements(unsigned char *out,
+                                            const void *data,
+                                            const uint32_t count,
+                                            const size_t size) {
+  const unsigned char *in = (const unsigned char *)data;
+  if (size == 1) {
+    memcpy(out, in, count);
+    return out + count;
+  }
+  for (uint32_t e = 0; e < count; ++e, in += size, out += size) {
+    if (size == 4) {
+      uint32_t bits = 0;
+      memcpy(&bits, in, sizeof(bits));
+      Store_u32(out, bits);
+    } else {
+      uint64_t bits = 0;
+      memcpy(&bits, in, sizeof(bits));
+      Store_u64(out, bits);
+    }
+  }
+  return out;
+}
+
+/**
+ * @brief Serializes @p info, which is nested @p nesting levels deep.
+ * @details Nested objects are locked and serialized recursively.
+ */
+static int Serialize(QInfo info, void *buffer, const size_t capacity,
+                     size_t *size, const int nesting) {
+  if (info->num_occupied < 0 ||
+      (uint64_t)info->num_occupied > (uint64_t)UINT32_MAX ||
+      nesting > QINFO_INTERNAL_MAXNESTING) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
+  size_t total = QINFO_INTERNAL_SERIALHEADER;
+  for (int i = Next_occupied(info, 0); i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    const QInfo_value_space_t *slot = Space_slot(info, i);
+    total += 5 + String_length(&slot->name) + Serial_value_size(slot);
+    if (slot->type == QINFO_TYPE_QINFO && slot->value.value_qinfo != NULL) {
+      QInfo child = slot->value.value_qinfo;
+      size_t nested = 0;
+      Read_lock(child);
+      const int err = Serialize(child, NULL, 0, &nested, nesting + 1);
+      Read_unlock(child);
+      if (!QInfo_is_Success(err)) {
+        return err;
+      }
+      if (nested >= QINFO_INTERNAL_SERIALUNSET) {
+        return QINFO_ERROR_OUTOFBOUNDS;
+      }
+      total += nested;
+    }
+  }
+  *size = total;
+  if (buffer == NULL) {
+    return QINFO_SUCCESS;
+  }
+  if (capacity < total) {
+    return QINFO_ERROR_OUTOFBOUNDS;
   }
 
-  for (int i = 0; i < (*info_out)->size; ++i) {
-    if (!info_in->value_space[i].occupied) {
-      (*info_out)->value_space[i].name = NULL;
-      (*info_out)->value_space[i].type = QINFO_TYPE_INT32;
-      (*info_out)->value_space[i].value.value_i32 = 0;
-      continue;
-    }
+  unsigned char *out = (unsigned char *)buffer;
+  const unsigned char *end = out + total;
+  Store_u32(out, QINFO_INTERNAL_SERIALMAGIC);
+  Store_u16(out + 4, QINFO_INTERNAL_SERIALVERSION);
+  Store_u16(out + 6, 0);
+  Store_u32(out + 8, (uint32_t)info->num_occupied);
+  out += QINFO_INTERNAL_SERIALHEADER;
+  for (int i = Next_occupied(info, 0); i < info->size;
+       i = Next_occupied(info, i + 1)) {
+    const QInfo_value_space_t *slot = Space_slot(info, i);
+    const uint32_t key_length = String_length(&slot->name);
+    out[0] = (unsigned char)slot->type;
+    Store_u32(out + 1, key_length);
+    memcpy(out + 5, String_data(&slot->name), key_length);
+    out += 5 + key_length;
 
-    (*info_out)->value_space[i].occupied = info_in->value_space[i].occupied;
-    (*info_out)->value_space[i].type = info_in->value_space[i].type;
-    (*info_out)->value_space[i].name = strdup(info_in->value_space[i].name);
-    if (info_in->value_space[i].type == QINFO_TYPE_STRING) {
-      if (info_in->value_space[i].value.value_string != NULL) {
-        (*info_out)->value_space[i].value.value_string =
-            strdup(info_in->value_space[i].value.value_string);
-      } else {
-        (*info_out)->value_space[i].value.value_string = NULL;
+    const QInfo_value *value = &slot->value;
+    switch (slot->type) {
+    case QINFO_TYPE_INT32:
+      Store_u32(out, (uint32_t)value->value_i32);
+      out += 4;
+      break;
+    case QINFO_TYPE_INT64:
+      Store_u64(out, (uint64_t)value->value_i64);
+      out += 8;
+      break;
+    case QINFO_TYPE_FLOAT: {
+      uint32_t bits = 0;
+      memcpy(&bits, &value->value_float, sizeof(bits));
+      Store_u32(out, bits);
+      out += 4;
+      break;
+    }
+    case QINFO_TYPE_DOUBLE: {
+      uint64_t bits = 0;
+      memcpy(&bits, &value->value_double, sizeof(bits));
+      Store_u64(out, bits);
+      out += 8;
+      break;
+    }
+    case QINFO_TYPE_STRING: {
+      const char *data = String_data(&value->value_string);
+      const uint32_t length = String_length(&value->value_string);
+      if (data == NULL) {
+        Store_u32(out, QINFO_INTERNAL_SERIALUNSET);
+        out += 4;
+        break;
       }
-    } else {
-      (*info_out)->value_space[i].value = info_in->value_space[i].value;
+      Store_u32(out, length);
+      memcpy(out + 4, data, length);
+      out += 4 + length;
+      break;
+    }
+    case QINFO_TYPE_INT32_ARRAY:
+    case QINFO_TYPE_INT64_ARRAY:
+    case QINFO_TYPE_FLOAT_ARRAY:
+    case QINFO_TYPE_DOUBLE_ARRAY:
+    case QINFO_TYPE_BLOB:
+      Store_u32(out, value->value_array.count);
+      out = Serial_write_elements(out + 4, value->value_array.data,
+                                  value->value_array.count,
+                                  Array_element_size(slot->type));
+      break;
+    case QINFO_TYPE_QINFO: {
+      QInfo child = value->value_qinfo;
+      if (child == NULL) {
+        Store_u32(out, QINFO_INTERNAL_SERIALUNSET);
+        out += 4;
+        break;
+      }
+      // Fails if the nested object grew since it was sized.
+      size_t nested = 0;
+      Read_lock(child);
+      const int err = Serialize(child, out + 4, (size_t)(end - out) - 4,
+                                &nested, nesting + 1);
+      Read_unlock(child);
+      if (!QInfo_is_Success(err)) {
+        return err;
+      }
+      Store_u32(out, (uint32_t)nested);
+      out += 4 + nested;
+      break;
+    }
     }
   }
+  return QINFO_SUCCESS;
+}
+
+int QInfo_serialize(QInfo info, void *buffer, const size_t capacity,
+                    size_t *size) {
+  Read_lock(info);
+  const int err = Serialize(info, buffer, capacity, size, 0);
+  Read_unlock(info);
+  return err;
+}
 
+/**
+ * @brief Validates the header of the serialized QInfo object of @p size bytes
+ * at @p in and reads its number of entries into @p num_entries.
+ * @return QINFO_SUCCESS on success, an error code otherwise.
+ */
+static int Serial_header(const unsigned char *in, const size_t size,
+                         uint32_t *num_entries) {
+  if (size < QINFO_INTERNAL_SERIALHEADER ||
+      Load_u32(in) != QINFO_INTERNAL_SERIALMAGIC ||
+      Load_u16(in + 4) != QINFO_INTERNAL_SERIALVERSION ||
+      Load_u16(in + 6) != 0) {
+    return QINFO_ERROR_INVALIDFORMAT;
+  }
+  *num_entries = Load_u32(in + 8);
+  if (*num_entries > INT_MAX) {
+    return QINFO_ERROR_OUTOFBOUNDS;
+  }
   return QINFO_SUCCESS;
 }
 
-int QInfo_free(QInfo info) {
-  for (int i = 0; i < info->size; ++i) {
-    if (!info->value_space[i].occupied) {
-      continue;
+/**
+ * @brief Validates the entries of a serialized QInfo object nested
+ * @p nesting levels deep and computes how many arena bytes their strings
+ * need.
+ * @details Nested objects are validated recursively, but their strings are
+ * not counted.
+ * @return QINFO_SUCCESS if all @p num_entries entries are well-formed and end
+ * exactly at @p end, QINFO_ERROR_INVALIDFORMAT otherwise.
+ */
+static int Serial_scan(const unsigned char *in, const unsigned char *end,
+                       const uint32_t num_entries, const int nesting,
+                       size_t *arena_bytes) {
+  size_t bytes = 0;
+  for (uint32_t k = 0; k < num_entries; ++k) {
+    if ((size_t)(end - in) < 5 || in[0] > QINFO_TYPE_QINFO) {
+      return QINFO_ERROR_INVALIDFORMAT;
+    }
+    const enum QINFO_TYPE type = (enum QINFO_TYPE)in[0];
+    const uint32_t key_length = Load_u32(in + 1);
+    in += 5;
+    if ((size_t)(end - in) < (size_t)key_length + 4) {
+      return QINFO_ERROR_INVALIDFORMAT;
+    }
+    if (key_length >= QINFO_INTERNAL_INLINESTRING) {
+      bytes += Arena_block_size(key_length);
     }
+    in += key_length;
 
-    free(info->value_space[i].name);
-    if (info->value_space[i].type == QINFO_TYPE_STRING) {
-      free(info->value_space[i].value.value_string);
+    size_t value_size = 4;
+    if (type == QINFO_TYPE_INT64 || type == QINFO_TYPE_DOUBLE) {
+      value_size = 8;
+    } else if (type == QINFO_TYPE_STRING) {
+      const uint32_t length = Load_u32(in);
+      if (length != QINFO_INTERNAL_SERIALUNSET) {
+        value_size += length;
+        if (length >= QINFO_INTERNAL_INLINESTRING) {
+          bytes += Arena_block_size(length);
+        }
+      }
+    } else if (Type_is_array(type)) {
+      const uint32_t count = Load_u32(in);
+      const size_t element_size = Array_element_size(type);
+      if (count > ((size_t)(end - in) - 4) / element_size) {
+        return QINFO_ERROR_INVALIDFORMAT;
+      }
+      value_size += (size_t)count * element_size;
+      if (count > 0) {
+        bytes += Arena_block_size((size_t)count * element_size) +
+                 QINFO_INTERNAL_ARRAYALIGN;
+      }
+    } else if (type == QINFO_TYPE_QINFO) {
+      const uint32_t length = Load_u32(in);
+      if (length != QINFO_INTERNAL_SERIALUNSET) {
+        if (length > (size_t)(end - in) - 4 ||
+            nesting == QINFO_INTERNAL_MAXNESTING) {
+          return QINFO_ERROR_INVALIDFORMAT;
+        }
+        uint32_t nested_entries = 0;
+        size_t nested_bytes = 0;
+        int err = Serial_header(in + 4, length, &nested_entries);
+        if (QInfo_is_Success(err)) {
+          err = Serial_scan(in + 4 + QINFO_INTERNAL_SERIALHEADER,
+                            in + 4 + length, nested_entries, nesting + 1,
+                            &nested_bytes);
+        }
+        if (!QInfo_is_Success(err)) {
+          return err;
+        }
+        value_size += length;
+      }
     }
+    if ((size_t)(end - in) < value_size) {
+      return QINFO_ERROR_INVALIDFORMAT;
+    }
+    in += value_size;
+  }
+  if (in != end) {
+    return QINFO_ERROR_INVALIDFORMAT;
   }
-  free(info->value_space);
-  free(info);
+  *arena_bytes = bytes;
   return QINFO_SUCCESS;
 }
 
-int QInfo_add(QInfo info, const char *key, const enum QINFO_TYPE type,
-              QInfo_index *index) {
-  // Check if key exists
-  for (int i = 0; i < info->size; ++i) {
-    if (info->value_space[i].occupied &&
-        strcmp(info->value_space[i].name, key) == 0) {
-      return QINFO_ERROR_KEYEXISTS;
+/**
+ * @brief Hints the processor to load the hash bucket of @p key into the cache.
+ */
+static inline void Index_prefetch(QInfo info, const QInfo_key *key) {
+  const QInfo_hash_bucket_t *bucket =
+      &info->index->buckets[(uint32_t)key->hash &
+                            (info->index->num_buckets - 1)];
+#if defined(_MSC_VER)
+  _mm_prefetch((const char *)bucket, _MM_HINT_T0);
+#else
+  __builtin_prefetch(bucket);
+#endif
+}
+
+/**
+ * @brief Reads the value serialized at @p in into @p value of type @p type.
+ * @return The position after the value, or NULL if out of memory.
+ */
+static const unsigned char *Serial_read_value(QInfo info,
+                                              const unsigned char *in,
+                                              const enum QINFO_TYPE type,
+                                              QInfo_value *value) {
+  switch (type) {
+  case QINFO_TYPE_INT32:
+    value->value_i32 = (int32_t)Load_u32(in);
+    return in + 4;
+  case QINFO_TYPE_INT64:
+    value->value_i64 = (int64_t)Load_u64(in);
+    return in + 8;
+  case QINFO_TYPE_FLOAT: {
+    const uint32_t bits = Load_u32(in);
+    memcpy(&value->value_float, &bits, sizeof(bits));
+    return in + 4;
+  }
+  case QINFO_TYPE_DOUBLE: {
+    const uint64_t bits = Load_u64(in);
+    memcpy(&value->value_double, &bits, sizeof(bits));
+    return in + 8;
+  }
+  case QINFO_TYPE_STRING: {
+    const uint32_t length = Load_u32(in);
+    if (length == QINFO_INTERNAL_SERIALUNSET) {
+      return in + 4;
     }
+    if (!QInfo_is_Success(String_assign(&info->arena, &value->value_string,
+                                        (const char *)in + 4, length))) {
+      return NULL;
+    }
+    return in + 4 + length;
   }
-
-  // Check if there is space
-  if (info->num_occupied == info->size) {
-    // Need more space
-    int old_size = info->size;
-    info->size += QINFO_INTERNAL_SPACEGRANULARITY;
-
-    QInfo_value_space_t *new_value_space = (QInfo_value_space_t *)realloc(
-        info->value_space,
-        sizeof(QInfo_value_space_t) * (unsigned long)info->size);
-    if (new_value_space == NULL) {
-      return QINFO_ERROR_OUTOFMEM;
+  case QINFO_TYPE_QINFO: {
+    const uint32_t length = Load_u32(in);
+    if (length == QINFO_INTERNAL_SERIALUNSET) {
+      return in + 4;
     }
-    info->value_space = new_value_space;
-
-    for (int i = old_size; i < info->size; ++i) {
-      info->value_space[i].occupied = 0;
-      info->value_space[i].name = NULL;
-      info->value_space[i].type = QINFO_TYPE_INT32;
-      info->value_space[i].value.value_i32 = 0;
+    QInfo child = NULL;
+    if (!QInfo_is_Success(QInfo_deserialize(in + 4, length, &child))) {
+      return NULL;
     }
+    child->owner = info;
+    info->num_children++;
+    value->value_qinfo = child;
+    return in + 4 + length;
   }
-
-  // Find empty slot and occupy it
-  for (int i = 0; i < info->size; ++i) {
-    if (info->value_space[i].occupied) {
-      continue;
+  case QINFO_TYPE_INT32_ARRAY:
+  case QINFO_TYPE_INT64_ARRAY:
+  case QINFO_TYPE_FLOAT_ARRAY:
+  case QINFO_TYPE_DOUBLE_ARRAY:
+  case QINFO_TYPE_BLOB: {
+    const uint32_t count = Load_u32(in);
+    const size_t size = Array_element_size(type);
+    in += 4;
+    if (count == 0) {
+      return in;
     }
-
-    info->value_space[i].name = strdup(key);
-    if (info->value_space[i].name == NULL) {
-      return QINFO_ERROR_OUTOFMEM;
+    unsigned char *out = (unsigned char *)Arena_alloc_array(
+        &info->arena, (size_t)count * size);
+    if (out == NULL) {
+      return NULL;
     }
-    info->value_space[i].occupied = 1;
-    info->value_space[i].type = type;
-    if (type == QINFO_TYPE_STRING) {
-      info->value_space[i].value.value_string = NULL;
+    value->value_array.data = out;
+    value->value_array.count = count;
+    if (size == 1) {
+      memcpy(out, in, count);
+      return in + count;
     }
-    info->num_occupied++;
-    *index = i;
-    return QINFO_SUCCESS;
+    for (uint32_t e = 0; e < count; ++e, in += size, out += size) {
+      if (size == 4) {
+        const uint32_t bits = Load_u32(in);
+        memcpy(out, &bits, sizeof(bits));
+      } else {
+        const uint64_t bits = Load_u64(in);
+        memcpy(out, &bits, sizeof(bits));
+      }
+    }
+    return in;
   }
-
-  // Somehow we had no space, which should never happen.
-  return QINFO_ERROR_FATAL;
+  }
+  return in;
 }
 
-static inline int Check_index(QInfo info, const QInfo_index index) {
-  if (index < 0 || index >= info->size) {
-    return QINFO_ERROR_OUTOFBOUNDS;
-  }
+/**
+ * @brief Adds the @p num_entries entries serialized at @p in to @p info.
+ * @details The input must have been validated with Serial_scan, and @p info
+ * must have room for all entries and strings. Keys are hashed a batch ahead
+ * of their insertion, so that the cache misses on their hash buckets overlap
+ * instead of stalling every insertion.
+ */
+static int Serial_read(QInfo info, const unsigned char *in,
+                       const uint32_t num_entries) {
+  QInfo_key keys[QINFO_INTERNAL_SERIALBATCH];
+  const unsigned char *values[QINFO_INTERNAL_SERIALBATCH];
+  for (uint32_t k = 0; k < num_entries; k += QINFO_INTERNAL_SERIALBATCH) {
+    const uint32_t batch = num_entries - k < QINFO_INTERNAL_SERIALBATCH
+                               ? num_entries - k
+                               : QINFO_INTERNAL_SERIALBATCH;
+    const unsigned char *next = in;
+    for (uint32_t j = 0; j < batch; ++j) {
+      QInfo_key_make((const char *)next + 5, Load_u32(next + 1), &keys[j]);
+      Index_prefetch(info, &keys[j]);
+      values[j] = next;
+      next += 5 + keys[j].length;
+      switch ((enum QINFO_TYPE)values[j][0]) {
+      case QINFO_TYPE_INT64:
+      case QINFO_TYPE_DOUBLE:
+        next += 8;
+        break;
+      case QINFO_TYPE_STRING:
+      case QINFO_TYPE_QINFO:
+        next += Load_u32(next) == QINFO_INTERNAL_SERIALUNSET
+                    ? 4
+                    : 4 + (size_t)Load_u32(next);
+        break;
+      case QINFO_TYPE_INT32_ARRAY:
+      case QINFO_TYPE_INT64_ARRAY:
+      case QINFO_TYPE_FLOAT_ARRAY:
+      case QINFO_TYPE_DOUBLE_ARRAY:
+      case QINFO_TYPE_BLOB:
+        next += 4 + (size_t)Load_u32(next) *
+                        Array_element_size((enum QINFO_TYPE)values[j][0]);
+        break;
+      default:
+        next += 4;
+        break;
+      }
+    }
 
-  if (!info->value_space[index].occupied) {
-    return QINFO_WARN_NOKEY;
+    for (uint32_t j = 0; j < batch; ++j) {
+      const enum QINFO_TYPE type = (enum QINFO_TYPE)values[j][0];
+      QInfo_index index = 0;
+      const int err = Add_key(info, &keys[j], type, &index);
+      if (!QInfo_is_Success(err)) {
+        return err;
+      }
+      if (Serial_read_value(info, values[j] + 5 + keys[j].length, type,
+                            &Space_slot(info, index)->value) == NULL) {
+        return QINFO_ERROR_OUTOFMEM;
+      }
+    }
+    in = next;
   }
-
   return QINFO_SUCCESS;
 }
 
-int QInfo_remove(QInfo info, const QInfo_index index) {
-  const int err = Check_index(info, index);
+int QInfo_deserialize(const void *buffer, const size_t size, QInfo *info) {
+  const unsigned char *in = (const unsigned char *)buffer;
+  uint32_t num_entries = 0;
+  int err = Serial_header(in, size, &num_entries);
   if (!QInfo_is_Success(err)) {
     return err;
   }
 
-  free(info->value_space[index].name);
-  if (info->value_space[index].type == QINFO_TYPE_STRING) {
-    free(info->value_space[index].value.value_string);
-  }
-
-  info->value_space[index].occupied = 0;
-  info->value_space[index].name = NULL;
-  info->value_space[index].type = QINFO_TYPE_INT32;
-  info->value_space[index].value.value_i32 = 0;
-  info->num_occupied--;
-  return QINFO_SUCCESS;
-}
-
-int QInfo_query(QInfo info, const char *key, QInfo_index *index) {
-  for (int i = 0; i < info->size; ++i) {
-    if (info->value_space[i].occupied &&
-        strcmp(info->value_space[i].name, key) == 0) {
-      *index = i;
-      return QINFO_SUCCESS;
-    }
+  // Validate everything first, so that the object and its strings can be
+  // allocated at once and the loop below cannot run out of input.
+  size_t arena_bytes = 0;
+  err = Serial_scan(in + QINFO_INTERNAL_SERIALHEADER, in + size, num_entries,
+                    0, &arena_bytes);
+  if (!QInfo_is_Success(err)) {
+    return err;
   }
-  return QINFO_WARN_NOKEY;
-}
 
-int QInfo_get_key(QInfo info, const QInfo_index index, char **key) {
-  const int err = Check_index(info, index);
+  QInfo out = NULL;
+  err = QInfo_create_with_capacity(&out, (int)num_entries);
   if (!QInfo_is_Success(err)) {
     return err;
   }
-
-  *key = strdup(info->value_space[index].name);
-  if (*key == NULL) {
-    return QINFO_ERROR_OUTOFMEM;
+  if (arena_bytes > 0) {
+    err = Arena_reserve(&out->arena, arena_bytes);
+  }
+  if (QInfo_is_Success(err)) {
+    err = Serial_read(out, in + QINFO_INTERNAL_SERIALHEADER, num_entries);
   }
-
-  return QINFO_SUCCESS;
-}
-
-int QInfo_get_type(QInfo info, const QInfo_index index, enum QINFO_TYPE *type) {
-  const int err = Check_index(info, index);
   if (!QInfo_is_Success(err)) {
+    QInfo_free(out);
     return err;
   }
 
-  *type = info->value_space[index].type;
+  *info = out;
   return QINFO_SUCCESS;
 }
 
-int QInfo_get_val_i32(QInfo info, const QInfo_index index, int32_t *val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
-    return err;
-  }
+/*
+ * Text format read by QInfo_load_buffer, one entry per line:
+ *
+ *   # comment
+ *   key:type = value   # trailing comment
+ *   key:type           # no value: 0, or an unset string
+ *
+ * The type is one of i32, i64, f32, f64, and str. Keys are non-empty and
+ * contain no whitespace, ':', '=', '#' or '"'. Integers are decimal,
+ * floating-point values use the syntax of strtod in the C locale. String
+ * values are either enclosed in double quotes, with the escapes \" \\ \n \r
+ * and \t, or unquoted, in which case they extend to the end of the line or
+ * a '#' and surrounding whitespace is trimmed.
+ */
 
-  if (info->value_space[index].type != QINFO_TYPE_INT32) {
-    return QINFO_ERROR_INVALIDTYPE;
-  }
+/**
+ * @brief Maximum length of a number in a text file.
+ */
+#define QINFO_INTERNAL_MAXNUMBER 64
 
-  *val = info->value_space[index].value.value_i32;
-  return QINFO_SUCCESS;
+/**
+ * @brief Internal structure for an entry parsed from a line of a text file.
+ * @details Keys and string values point into the text.
+ */
+typedef struct QInfo_text_entry_d {
+  QInfo_key key;        /**< The key. */
+  enum QINFO_TYPE type; /**< The type of the value. */
+  int has_value;        /**< Whether a value is given. */
+  int escaped;          /**< Whether the string value contains escapes. */
+  const char *str;      /**< The string value, without quotes. */
+  size_t str_length;    /**< The length of the string value. */
+  QInfo_value value;    /**< The numeric value. */
+} QInfo_text_entry_t;
+
+static inline int Is_space(const char c) {
+  return c == ' ' || c == '\t' || c == '\r';
 }
 
-int QInfo_get_val_i64(QInfo info, const QInfo_index index, int64_t *val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
-    return err;
+static inline const char *Skip_spaces(const char *pos, const char *end) {
+  while (pos < end && Is_space(*pos)) {
+    ++pos;
   }
+  return pos;
+}
 
-  if (info->value_space[index].type != QINFO_TYPE_INT64) {
-    return QINFO_ERROR_INVALIDTYPE;
+/**
+ * @brief Parses the type annotation at [@p pos, @p end).
+ * @return The position after the type, or NULL if there is no valid type.
+ */
+static const char *Parse_type(const char *pos, const char *end,
+                              enum QINFO_TYPE *type) {
+  static const struct {
+    char name[4];
+    enum QINFO_TYPE type;
+  } types[] = {{"i32", QINFO_TYPE_INT32},
+               {"i64", QINFO_TYPE_INT64},
+               {"f32", QINFO_TYPE_FLOAT},
+               {"f64", QINFO_TYPE_DOUBLE},
+               {"str", QINFO_TYPE_STRING}};
+  if (end - pos < 3) {
+    return NULL;
   }
-
-  *val = info->value_space[index].value.value_i64;
-  return QINFO_SUCCESS;
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+    if (memcmp(pos, types[i].name, 3) == 0) {
+      *type = types[i].type;
+      return pos + 3;
+    }
+  }
+  return NULL;
 }
 
-int QInfo_get_val_f(QInfo info, const QInfo_index index, float *val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
-    return err;
+/**
+ * @brief Parses the decimal integer at [@p pos, @p end) into the range
+ * [@p min, @p max].
+ * @return The position after the number, or NULL if there is no valid number.
+ */
+static const char *Parse_integer(const char *pos, const char *end,
+                                 const int64_t min, const int64_t max,
+                                 int64_t *val) {
+  const int negative = pos < end && *pos == '-';
+  if (pos < end && (*pos == '-' || *pos == '+')) {
+    ++pos;
   }
-
-  if (info->value_space[index].type != QINFO_TYPE_FLOAT) {
-    return QINFO_ERROR_INVALIDTYPE;
+  // Accumulate the magnitude, which may exceed INT64_MAX by one.
+  const uint64_t limit = negative ? (uint64_t)0 - (uint64_t)min : (uint64_t)max;
+  uint64_t magnitude = 0;
+  const char *digits = pos;
+  while (pos < end && *pos >= '0' && *pos <= '9') {
+    const unsigned digit = (unsigned)(*pos - '0');
+    if (magnitude > (limit - digit) / 10) {
+      return NULL;
+    }
+    magnitude = magnitude * 10 + digit;
+    ++pos;
   }
-
-  *val = info->value_space[index].value.value_float;
-  return QINFO_SUCCESS;
+  if (pos == digits) {
+    return NULL;
+  }
+  *val = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+  return pos;
 }
 
-int QInfo_get_val_d(QInfo info, const QInfo_index index, double *val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
-    return err;
+/**
+ * @brief Parses the floating-point number at [@p pos, @p end).
+ * @details The number is copied to the stack, since strtod needs a
+ * terminated string.
+ * @return The position after the number, or NULL if there is no valid number.
+ */
+static const char *Parse_real(const char *pos, const char *end,
+                              double *val) {
+  const char *token_end = pos;
+  while (token_end < end && !Is_space(*token_end) && *token_end != '#') {
+    ++token_end;
   }
-
-  if (info->value_space[index].type != QINFO_TYPE_DOUBLE) {
-    return QINFO_ERROR_INVALIDTYPE;
+  const size_t length = (size_t)(token_end - pos);
+  if (length == 0 || length >= QINFO_INTERNAL_MAXNUMBER) {
+    return NULL;
   }
-
-  *val = info->value_space[index].value.value_double;
-  return QINFO_SUCCESS;
+  char number[QINFO_INTERNAL_MAXNUMBER];
+  memcpy(number, pos, length);
+  number[length] = '\0';
+  char *parsed = NULL;
+  *val = strtod(number, &parsed);
+  return parsed == number + length ? token_end : NULL;
 }
 
-int QInfo_get_val_c(QInfo info, const QInfo_index index, char **val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
-    return err;
+/**
+ * @brief Parses the string value at [@p pos, @p end) into @p entry.
+ * @return The position after the value, or NULL if the value is malformed.
+ */
+static const char *Parse_string(const char *pos, const char *end,
+                                QInfo_text_entry_t *entry) {
+  if (*pos != '"') {
+    const char *value_end = pos;
+    while (value_end < end && *value_end != '#') {
+      ++value_end;
+    }
+    const char *trimmed = value_end;
+    while (trimmed > pos && Is_space(trimmed[-1])) {
+      --trimmed;
+    }
+    entry->str = pos;
+    entry->str_length = (size_t)(trimmed - pos);
+    return value_end;
   }
 
-  if (info->value_space[index].type != QINFO_TYPE_STRING) {
-    return QINFO_ERROR_INVALIDTYPE;
+  entry->str = ++pos;
+  while (pos < end && *pos != '"') {
+    if (*pos == '\\') {
+      entry->escaped = 1;
+      if (++pos == end || *pos == '\0' || strchr("\"\\nrt", *pos) == NULL) {
+        return NULL;
+      }
+    }
+    ++pos;
   }
-
-  *val = strdup(info->value_space[index].value.value_string);
-  if (*val == NULL) {
-    return QINFO_ERROR_OUTOFMEM;
+  if (pos == end) {
+    return NULL;
   }
-
-  return QINFO_SUCCESS;
+  entry->str_length = (size_t)(pos - entry->str);
+  return pos + 1;
 }
 
-int QInfo_set_i32(QInfo info, const QInfo_index index, int32_t val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
-    return err;
+/**
+ * @brief Parses the line [@p pos, @p end) of a text file.
+ * @return QINFO_SUCCESS if the line holds an entry, QINFO_WARN_NOKEY if it is
+ * empty or a comment, QINFO_ERROR_INVALIDFORMAT if it is malformed.
+ */
+static int Parse_line(const char *pos, const char *end,
+                      QInfo_text_entry_t *entry) {
+  pos = Skip_spaces(pos, end);
+  if (pos == end || *pos == '#') {
+    return QINFO_WARN_NOKEY;
   }
 
-  if (info->value_space[index].type != QINFO_TYPE_INT32) {
-    return QINFO_ERROR_INVALIDTYPE;
+  const char *key = pos;
+  while (pos < end && !Is_space(*pos) && *pos != ':' && *pos != '=' &&
+         *pos != '#' && *pos != '"') {
+    ++pos;
   }
-
-  info->value_space[index].value.value_i32 = val;
-  return QINFO_SUCCESS;
-}
-
-int QInfo_set_i64(QInfo info, const QInfo_index index, int64_t val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
-    return err;
+  if (pos == key || (size_t)(pos - key) > UINT32_MAX || pos == end ||
+      *pos != ':') {
+    return QINFO_ERROR_INVALIDFORMAT;
+  }
+  QInfo_key_make(key, (size_t)(pos - key), &entry->key);
+  pos = Parse_type(pos + 1, end, &entry->type);
+  if (pos == NULL) {
+    return QINFO_ERROR_INVALIDFORMAT;
   }
 
-  if (info->value_space[index].type != QINFO_TYPE_INT64) {
-    return QINFO_ERROR_INVALIDTYPE;
+  pos = Skip_spaces(pos, end);
+  entry->has_value = pos < end && *pos == '=';
+  entry->escaped = 0;
+  if (entry->has_value) {
+    pos = Skip_spaces(pos + 1, end);
+    if (pos == end || *pos == '#') {
+      return QINFO_ERROR_INVALIDFORMAT;
+    }
+    int64_t integer = 0;
+    double real = 0.0;
+    switch (entry->type) {
+    case QINFO_TYPE_INT32:
+      pos = Parse_integer(pos, end, INT32_MIN, INT32_MAX, &integer);
+      entry->value.value_i32 = (int32_t)integer;
+      break;
+    case QINFO_TYPE_INT64:
+      pos = Parse_integer(pos, end, INT64_MIN, INT64_MAX, &integer);
+      entry->value.value_i64 = integer;
+      break;
+    case QINFO_TYPE_FLOAT:
+      pos = Parse_real(pos, end, &real);
+      entry->value.value_float = (float)real;
+      break;
+    case QINFO_TYPE_DOUBLE:
+      pos = Parse_real(pos, end, &real);
+      entry->value.value_double = real;
+      break;
+    case QINFO_TYPE_STRING:
+      pos = Parse_string(pos, end, entry);
+      if (pos != NULL && entry->str_length > UINT32_MAX) {
+        pos = NULL;
+      }
+      break;
+    default: /* Parse_type never yields an array type */
+      pos = NULL;
+      break;
+    }
+    if (pos == NULL) {
+      return QINFO_ERROR_INVALIDFORMAT;
+    }
+    pos = Skip_spaces(pos, end);
   }
 
-  info->value_space[index].value.value_i64 = val;
-  return QINFO_SUCCESS;
+  return pos == end || *pos == '#' ? QINFO_SUCCESS
+                                   : QINFO_ERROR_INVALIDFORMAT;
 }
 
-int QInfo_set_f(QInfo info, const QInfo_index index, float val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
-    return err;
-  }
-
-  if (info->value_space[index].type != QINFO_TYPE_FLOAT) {
-    return QINFO_ERROR_INVALIDTYPE;
+/**
+ * @brief Decodes the escapes of a quoted string value into @p out.
+ * @return The length of the decoded string.
+ */
+static size_t Unescape(const char *str, const size_t length, char *out) {
+  size_t n = 0;
+  for (size_t i = 0; i < length; ++i) {
+    char c = str[i];
+    if (c == '\\') {
+      c = str[++i];
+      c = c == 'n' ? '\n' : c == 'r' ? '\r' : c == 't' ? '\t' : c;
+    }
+    out[n++] = c;
   }
-
-  info->value_space[index].value.value_float = val;
-  return QINFO_SUCCESS;
+  return n;
 }
 
-int QInfo_set_d(QInfo info, const QInfo_index index, double val) {
-  const int err = Check_index(info, index);
-  if (!QInfo_is_Success(err)) {
+/**
+ * @brief Adds the parsed entry @p entry to @p info.
+ * @details @p scratch must have room for the string value of the entry.
+ */
+static int Text_add(QInfo info, const QInfo_text_entry_t *entry,
+                    char *scratch) {
+  QInfo_index index = 0;
+  const int err = Add_key(info, &entry->key, entry->type, &index);
+  if (!QInfo_is_Success(err) || !entry->has_value) {
     return err;
   }
 
-  if (info->value_space[index].type != QINFO_TYPE_DOUBLE) {
-    return QINFO_ERROR_INVALIDTYPE;
+  QInfo_value *value = &Space_slot(info, index)->value;
+  if (entry->type != QINFO_TYPE_STRING) {
+    *value = entry->value;
+    return QINFO_SUCCESS;
+  }
+  const char *str = entry->str;
+  size_t length = entry->str_length;
+  if (entry->escaped) {
+    length = Unescape(str, length, scratch);
+    str = scratch;
   }
+  const int err_assign =
+      String_assign(&info->arena, &value->value_string, str, length);
+  if (!QInfo_is_Success(err_assign)) {
+    // The rollback of the caller only covers the lines before this one.
+    Remove(info, index);
+  }
+  return err_assign;
+}
 
-  info->value_space[index].value.value_double = val;
-  return QINFO_SUCCESS;
+/**
+ * @brief Removes the entries of the first @p num_lines lines of the text
+ * [@p pos, @p end) from @p info.
+ * @details Rolls back a partially loaded text. All these lines have been
+ * parsed and added successfully before.
+ */
+static void Text_remove(QInfo info, const char *pos, const char *end,
+                        size_t num_lines) {
+  for (; num_lines > 0; --num_lines) {
+    const char *eol = (const char *)memchr(pos, '\n', (size_t)(end - pos));
+    const char *line_end = eol == NULL ? end : eol;
+    QInfo_text_entry_t entry;
+    if (QInfo_is_Success(Parse_line(pos, line_end, &entry))) {
+      Remove(info, Index_find(info, &entry.key));
+    }
+    pos = line_end + 1;
+  }
 }
 
-int QInfo_set_c(QInfo info, const QInfo_index index, const char *val) {
-  const int err = Check_index(info, index);
+static int Load_buffer(QInfo info, const char *buffer, const size_t size,
+                       size_t *error_line) {
+  const char *end = buffer + size;
+
+  // Every entry takes a line, so the number of lines bounds the number of
+  // entries. Reserving for all of them avoids any growth while parsing.
+  size_t num_lines = 1;
+  size_t longest = 0;
+  for (const char *pos = buffer; pos < end;) {
+    const char *eol = (const char *)memchr(pos, '\n', (size_t)(end - pos));
+    if (eol == NULL) {
+      eol = end;
+    }
+    longest = (size_t)(eol - pos) > longest ? (size_t)(eol - pos) : longest;
+    if (eol < end) {
+      ++num_lines;
+    }
+    pos = eol + 1;
+  }
+  if (num_lines > (size_t)(INT_MAX - info->num_occupied)) {
+    return QINFO_ERROR_OUTOFMEM;
+  }
+  int err = Space_reserve(info, info->num_occupied + (int)num_lines);
   if (!QInfo_is_Success(err)) {
     return err;
   }
-
-  if (info->value_space[index].type != QINFO_TYPE_STRING) {
-    return QINFO_ERROR_INVALIDTYPE;
-  }
-
-  free(info->value_space[index].value.value_string);
-  info->value_space[index].value.value_string = strdup(val);
-  if (info->value_space[index].value.value_string == NULL) {
+  // Room for decoding quoted strings, which are never longer than a line.
+  char *scratch = (char *)malloc(longest + 1);
+  if (scratch == NULL) {
     return QINFO_ERROR_OUTOFMEM;
   }
 
-  return QINFO_SUCCESS;
-}
+  // Parse a batch of lines before adding their entries, so that the cache
+  // misses on the hash buckets of the keys overlap.
+  QInfo_text_entry_t entries[QINFO_INTERNAL_SERIALBATCH];
+  size_t lines[QINFO_INTERNAL_SERIALBATCH];
+  size_t line = 0;
+  const char *pos = buffer;
+  while (pos < end && QInfo_is_Success(err)) {
+    size_t batch = 0;
+    while (batch < QINFO_INTERNAL_SERIALBATCH && pos < end) {
+      const char *eol = (const char *)memchr(pos, '\n', (size_t)(end - pos));
+      const char *line_end = eol == NULL ? end : eol;
+      ++line;
+      err = Parse_line(pos, line_end, &entries[batch]);
+      pos = line_end + 1;
+      if (QInfo_is_Success(err)) {
+        Index_prefetch(info, &entries[batch].key);
+        lines[batch++] = line;
+      } else if (err == QINFO_WARN_NOKEY) {
+        err = QINFO_SUCCESS;
+      } else {
+        break;
+      }
+    }
 
-QInfo_iterator QInfo_begin(QInfo info) {
-  for (int i = 0; i < info->size; ++i) {
-    if (info->value_space[i].occupied) {
-      return i;
+    // Entries of all lines before a malformed one are added nevertheless, so
+    // that the rollback below can remove them.
+    for (size_t j = 0; j < batch; ++j) {
+      const int err_add = Text_add(info, &entries[j], scratch);
+      if (!QInfo_is_Success(err_add)) {
+        err = err_add;
+        line = lines[j];
+        break;
+      }
     }
   }
-  return QInfo_end(info);
-}
+  free(scratch);
 
-QInfo_iterator QInfo_end(QInfo info) { return info->size; }
-
-void QInfo_next(QInfo info, QInfo_iterator *iter) {
-  for (int i = *iter + 1; i < info->size; ++i) {
-    if (info->value_space[i].occupied) {
-      *iter = i;
-      return;
+  if (!QInfo_is_Success(err)) {
+    // Either all or none of the entries are added.
+    Text_remove(info, buffer, end, line - 1);
+    if (error_line != NULL) {
+      *error_line = line;
     }
   }
-  *iter = QInfo_end(info);
+  return err;
+}
+
+int QInfo_load_buffer(QInfo info, const char *buffer, const size_t size,
+                      size_t *error_line) {
+  Write_lock(info);
+  const int err = Load_buffer(info, buffer, size, error_line);
+  Write_unlock(info);
+  return err;
 }
 
-int QInfo_empty(QInfo info) { return info->num_occupied == 0; }
+int QInfo_load_file(QInfo info, const char *path, size_t *error_line) {
+  const char *base = NULL;
+  size_t size = 0;
+  int err = File_map(path, &base, &size);
+  if (!QInfo_is_Success(err)) {
+    return err;
+  }
+  err = QInfo_load_buffer(info, base, size, error_line);
+  File_unmap(base, size);
+  return err;
+}
@@ -6,10 +6,17 @@ SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
 #include "qinfo.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <gtest/gtest.h>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 class QInfoTest : public ::testing::Test {
 protected:
@@ -472,3 +479,2046 @@ TEST_F(QInfoTest, onEmptyObjectBeginEqualsEnd) {
   ASSERT_EQ(QInfo_begin(info), QInfo_end(info))
       << "Begin and end should be equal";
 }
+
+TEST_F(QInfoTest, queryAfterInterleavedRemove) {
+  constexpr std::size_t num_keys = 1000;
+
+  std::vector<QInfo_index> indices(num_keys);
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    const std::string key = "key_" + std::to_string(i);
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_INT32, &indices[i])))
+        << "Could not add key";
+  }
+
+  for (std::size_t i = 0; i < num_keys; i += 3) {
+    ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, indices[i])))
+        << "Could not remove key";
+  }
+
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    const std::string key = "key_" + std::to_string(i);
+    QInfo_index index{};
+    const int err = QInfo_query(info, key.c_str(), &index);
+    if (i % 3 == 0) {
+      ASSERT_EQ(err, QINFO_WARN_NOKEY) << "Removed key still found";
+    } else {
+      ASSERT_TRUE(QInfo_is_Success(err)) << "Could not query key";
+      ASSERT_EQ(index, indices[i]) << "Index changed";
+    }
+  }
+
+  QInfo info2{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &info2)))
+      << "Could not duplicate info";
+  for (std::size_t i = 1; i < num_keys; i += 3) {
+    const std::string key = "key_" + std::to_string(i);
+    QInfo_index index{};
+    ASSERT_TRUE(QInfo_is_Success(QInfo_query(info2, key.c_str(), &index)))
+        << "Could not query key in duplicate";
+    ASSERT_EQ(index, indices[i]) << "Index differs in duplicate";
+  }
+  ASSERT_TRUE(QInfo_is_Error(
+      QInfo_add(info2, "key_1", QINFO_TYPE_INT32, &indices[0])))
+      << "Should not be able to add existing key to duplicate";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info2))) << "Free failed";
+}
+
+TEST(QInfoCapacityTest, createWithCapacityAndReserve) {
+  constexpr int capacity = 1000;
+
+  QInfo info{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create_with_capacity(&info, capacity)))
+      << "Creation failed";
+  ASSERT_TRUE(QInfo_empty(info)) << "Info should be empty";
+
+  QInfo_index first{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "first", QINFO_TYPE_INT32, &first)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i32(info, first, capacity)))
+      << "Could not set int value";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_reserve(info, 4 * capacity)))
+      << "Could not reserve";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_reserve(info, 0)))
+      << "Shrinking reserve should be a no-op";
+  ASSERT_TRUE(QInfo_is_Error(QInfo_reserve(info, -1)))
+      << "Should not be able to reserve negative capacity";
+
+  for (int i = 0; i < 4 * capacity; ++i) {
+    const std::string key = "key_" + std::to_string(i);
+    QInfo_index index{};
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_INT32, &index)))
+        << "Could not add key";
+  }
+
+  QInfo_index index{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "first", &index)))
+      << "Could not query key";
+  ASSERT_EQ(index, first) << "Index changed after growth";
+  int value{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i32(info, index, &value)))
+      << "Could not get int value";
+  ASSERT_EQ(value, capacity) << "Value changed after growth";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Free failed";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create_with_capacity(&info, 0)))
+      << "Creation with zero capacity failed";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(info, "a", QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(info, "b", QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Free failed";
+}
+
+TEST_F(QInfoTest, churnReusesSlotsAndIteratesOccupied) {
+  constexpr std::size_t num_keys = 200;
+
+  std::vector<QInfo_index> indices(num_keys);
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    const std::string key = "key_" + std::to_string(i);
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_INT64, &indices[i])))
+        << "Could not add key";
+  }
+
+  // Keep every tenth key and remove all others.
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    if (i % 10 != 0) {
+      ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, indices[i])))
+          << "Could not remove key";
+    }
+  }
+
+  std::size_t count = 0;
+  for (QInfo_iterator it = QInfo_begin(info); it < QInfo_end(info);
+       QInfo_next(info, &it)) {
+    ASSERT_EQ(it, indices[count * 10]) << "Unexpected iteration order";
+    ++count;
+  }
+  ASSERT_EQ(count, num_keys / 10) << "Wrong number of iterated entries";
+
+  // Re-adding transient keys must reuse vacated slots instead of growing.
+  for (int round = 0; round < 100; ++round) {
+    QInfo_index index{};
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, "transient", QINFO_TYPE_INT32, &index)))
+        << "Could not add key";
+    ASSERT_LT(index, static_cast<QInfo_index>(num_keys))
+        << "Vacated slot was not reused";
+    ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, index)))
+        << "Could not remove key";
+  }
+}
+
+TEST_F(QInfoTest, peekKeyAndStringValue) {
+  QInfo_index index{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "backend", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+
+  const char *key{};
+  std::size_t length{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_key(info, index, &key, &length)))
+      << "Could not peek key";
+  ASSERT_STREQ(key, "backend") << "Wrong key";
+  ASSERT_EQ(length, 7) << "Wrong key length";
+
+  const char *value{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(info, index, &value, &length)))
+      << "Could not peek unset string value";
+  ASSERT_EQ(value, nullptr) << "Unset string value should be null";
+  ASSERT_EQ(length, 0) << "Unset string value should be empty";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, "simulator")))
+      << "Could not set string value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(info, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_STREQ(value, "simulator") << "Wrong value";
+
+  // Peeking repeatedly returns the same storage instead of fresh copies.
+  const char *value2{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(info, index, &value2, &length)))
+      << "Could not peek string value";
+  ASSERT_EQ(value, value2) << "Peek should not copy";
+  ASSERT_EQ(length, 9) << "Wrong value length";
+
+  QInfo_index index2{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "shots", QINFO_TYPE_INT32, &index2)))
+      << "Could not add key";
+  ASSERT_EQ(QInfo_peek_val_c(info, index2, &value, &length),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Should not be able to peek string value of int key";
+  ASSERT_TRUE(QInfo_is_Error(QInfo_peek_key(info, -1, &key, &length)))
+      << "Should not be able to peek key out of bounds";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, index)))
+      << "Could not remove key";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_peek_key(info, index, &key, &length)))
+      << "Should not be able to peek removed key";
+}
+
+TEST_F(QInfoTest, arenaReusesAndCompacts) {
+  std::size_t live{};
+  std::size_t wasted{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_arena_usage(info, &live, &wasted)))
+      << "Could not get arena usage";
+  ASSERT_EQ(live, 0) << "Empty info should not hold strings";
+  ASSERT_EQ(wasted, 0) << "Empty info should not waste memory";
+
+  QInfo_index index{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "scheduler.transient_hint", QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_arena_usage(info, &live, nullptr)))
+      << "Could not get arena usage";
+  const std::size_t key_bytes = live;
+  ASSERT_GT(key_bytes, 0) << "Key should be stored in the arena";
+
+  // Removing and re-adding a key of the same length reuses its memory.
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, index)))
+        << "Could not remove key";
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, "scheduler.transient_hint", QINFO_TYPE_INT32, &index)))
+        << "Could not add key";
+  }
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_arena_usage(info, &live, &wasted)))
+      << "Could not get arena usage";
+  ASSERT_EQ(live, key_bytes) << "Live bytes should not grow under churn";
+  ASSERT_EQ(wasted, 0) << "Released key should have been reused";
+
+  QInfo_index index2{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "payload", QINFO_TYPE_STRING, &index2)))
+      << "Could not add key";
+  const std::string long_value(1000, 'x');
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index2, long_value.c_str())))
+      << "Could not set string value";
+  const std::string short_value(100, 'y');
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index2, short_value.c_str())))
+      << "Could not set string value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_arena_usage(info, nullptr, &wasted)))
+      << "Could not get arena usage";
+  ASSERT_GE(wasted, long_value.size()) << "Overwritten value is not wasted";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_compact(info))) << "Could not compact";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_arena_usage(info, &live, &wasted)))
+      << "Could not get arena usage";
+  ASSERT_EQ(wasted, 0) << "Compaction should reclaim all wasted memory";
+
+  const char *key{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_key(info, index, &key, nullptr)))
+      << "Could not peek key";
+  ASSERT_STREQ(key, "scheduler.transient_hint") << "Key changed by compaction";
+  const char *value{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(info, index2, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(value, short_value) << "Value changed by compaction";
+}
+
+TEST_F(QInfoTest, shortStringsAreStoredInline) {
+  const std::string max_inline(15, 'k');
+  QInfo_index index{};
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_add(info, max_inline.c_str(), QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, "ibm")))
+      << "Could not set string value";
+
+  std::size_t live{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_arena_usage(info, &live, nullptr)))
+      << "Could not get arena usage";
+  ASSERT_EQ(live, 0) << "Short strings should not use the arena";
+
+  // Switch the value between inline and arena storage and back.
+  const std::string long_value(16, 'v');
+  const std::vector<std::string> values = {long_value, "", max_inline,
+                                           long_value + long_value, "x"};
+  for (const auto &value : values) {
+    ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, value.c_str())))
+        << "Could not set string value";
+    const char *peeked{};
+    std::size_t length{};
+    ASSERT_TRUE(
+        QInfo_is_Success(QInfo_peek_val_c(info, index, &peeked, &length)))
+        << "Could not peek string value";
+    ASSERT_EQ(peeked, value) << "Values do not match";
+    ASSERT_EQ(length, value.size()) << "Lengths do not match";
+  }
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_arena_usage(info, &live, nullptr)))
+      << "Could not get arena usage";
+  ASSERT_EQ(live, 0) << "Arena should not hold strings after going inline";
+
+  QInfo info2{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &info2)))
+      << "Could not duplicate info";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, index)))
+      << "Could not remove key";
+
+  QInfo_index index2{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_query(info2, max_inline.c_str(), &index2)))
+      << "Could not query key in duplicate";
+  char *copy{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_c(info2, index2, &copy)))
+      << "Could not get string value";
+  ASSERT_STREQ(copy, "x") << "Values do not match";
+  free(copy); // NOLINT(*-owning-memory, *-no-malloc)
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info2))) << "Free failed";
+}
+
+TEST_F(QInfoTest, lengthAwareAndPrehashedKeys) {
+  const std::string config = "shots=1000;seed=7";
+
+  QInfo_index index{};
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_add_n(info, config.data(), 5, QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+
+  QInfo_index index2{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "shots", &index2)))
+      << "Could not query key";
+  ASSERT_EQ(index, index2) << "Different indices for the same key";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_query_n(info, "shots", 4, &index2)))
+      << "Prefix of a key should not match";
+
+  QInfo_key key{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_key_make("shots", 5, &key)))
+      << "Could not make key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query_key(info, &key, &index2)))
+      << "Could not query key";
+  ASSERT_EQ(index, index2) << "Different indices for the same key";
+  ASSERT_EQ(QInfo_add_key(info, &key, QINFO_TYPE_INT32, &index2),
+            QINFO_ERROR_KEYEXISTS)
+      << "Should not be able to add existing key";
+
+  // Keys with explicit length may contain embedded null characters.
+  const char embedded[] = {'a', '\0', 'b'};
+  QInfo_key key2{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_key_make(embedded, 3, &key2)))
+      << "Could not make key";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add_key(info, &key2, QINFO_TYPE_INT64, &index2)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_query(info, "a", &index)))
+      << "Key should not be truncated at the null character";
+  const char *peeked{};
+  std::size_t length{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_key(info, index2, &peeked, &length)))
+      << "Could not peek key";
+  ASSERT_EQ(std::string(peeked, length), std::string(embedded, 3))
+      << "Keys do not match";
+}
+
+TEST_F(QInfoTest, batchAddQueryGetSet) {
+  const std::vector<const char *> keys = {"shots", "seed", "fidelity",
+                                          "backend"};
+  const std::vector<QINFO_TYPE> types = {QINFO_TYPE_INT32, QINFO_TYPE_INT32,
+                                         QINFO_TYPE_DOUBLE, QINFO_TYPE_STRING};
+  std::vector<QInfo_index> indices(keys.size());
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add_many(info, keys.size(), keys.data(),
+                                              types.data(), indices.data())))
+      << "Could not add keys";
+
+  std::vector<QInfo_index> queried(keys.size());
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_query_many(info, keys.size(), keys.data(), queried.data())))
+      << "Could not query keys";
+  ASSERT_EQ(indices, queried) << "Different indices for the same keys";
+
+  const std::vector<int32_t> ints = {1000, 7};
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_set_many_i32(info, ints.size(), indices.data(), ints.data())))
+      << "Could not set int values";
+  std::vector<int32_t> ints2(ints.size());
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_get_many_i32(info, ints.size(), indices.data(), ints2.data())))
+      << "Could not get int values";
+  ASSERT_EQ(ints, ints2) << "Values do not match";
+
+  const double fidelity = 0.99;
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_set_many_d(info, 1, &indices[2], &fidelity)))
+      << "Could not set double value";
+  double fidelity2{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_get_many_d(info, 1, &indices[2], &fidelity2)))
+      << "Could not get double value";
+  ASSERT_EQ(fidelity, fidelity2) << "Values do not match";
+
+  const char *backend = "simulator";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_many_c(info, 1, &indices[3], &backend)))
+      << "Could not set string value";
+  const char *backend2{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_peek_many_c(info, 1, &indices[3], &backend2)))
+      << "Could not peek string value";
+  ASSERT_STREQ(backend, backend2) << "Values do not match";
+
+  // Mismatching types are rejected before anything is written.
+  const std::vector<int32_t> wrong = {1, 2, 3};
+  ASSERT_EQ(QInfo_set_many_i32(info, wrong.size(), indices.data(),
+                               wrong.data()),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Should not be able to set int value for double key";
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_get_many_i32(info, ints.size(), indices.data(), ints2.data())))
+      << "Could not get int values";
+  ASSERT_EQ(ints, ints2) << "Values changed by rejected batch";
+
+  // Missing keys are reported per key.
+  const std::vector<const char *> missing = {"seed", "unknown"};
+  ASSERT_EQ(QInfo_query_many(info, missing.size(), missing.data(),
+                             queried.data()),
+            QINFO_WARN_NOKEY)
+      << "Should report missing key";
+  ASSERT_EQ(queried[0], indices[1]) << "Wrong index for existing key";
+  ASSERT_EQ(queried[1], -1) << "Missing key should have index -1";
+
+  // Adding is all-or-nothing.
+  const std::vector<const char *> clash = {"new", "shots"};
+  ASSERT_EQ(QInfo_add_many(info, clash.size(), clash.data(), types.data(),
+                           queried.data()),
+            QINFO_ERROR_KEYEXISTS)
+      << "Should not be able to add existing key";
+  QInfo_index index{};
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_query(info, "new", &index)))
+      << "Failed batch should not add any key";
+}
+
+TEST_F(QInfoTest, duplicateIsCopyOnWrite) {
+  constexpr std::size_t num_keys = 300;
+  std::vector<QInfo_index> indices(num_keys);
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    const std::string key = "calibration.key_" + std::to_string(i);
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_INT64, &indices[i])))
+        << "Could not add key";
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_set_i64(info, indices[i], static_cast<int64_t>(i))))
+        << "Could not set long value";
+  }
+  QInfo_index backend{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "backend", QINFO_TYPE_STRING, &backend)))
+      << "Could not add key";
+  const std::string device = "superconducting-device-a";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, backend, device.c_str())))
+      << "Could not set string value";
+
+  QInfo copy{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate info";
+
+  // Modifications of the duplicate are not visible in the original.
+  const std::string device2 = "superconducting-device-b";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i64(copy, indices[0], -1)))
+      << "Could not set long value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(copy, backend, device2.c_str())))
+      << "Could not set string value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(copy, indices[1])))
+      << "Could not remove key";
+  QInfo_index job{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(copy, "job.id", QINFO_TYPE_INT32, &job)))
+      << "Could not add key";
+
+  int64_t value{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(info, indices[0], &value)))
+      << "Could not get long value";
+  ASSERT_EQ(value, 0) << "Original changed by duplicate";
+  const char *peeked{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_peek_val_c(info, backend, &peeked, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(peeked, device) << "Original changed by duplicate";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(info, indices[1], &value)))
+      << "Key removed from duplicate is missing in original";
+  QInfo_index index{};
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_query(info, "job.id", &index)))
+      << "Key added to duplicate is present in original";
+
+  // The duplicate only holds the strings written after duplication.
+  std::size_t live{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_arena_usage(copy, &live, nullptr)))
+      << "Could not get arena usage";
+  ASSERT_LE(live, 2 * device2.size()) << "Duplicate copied shared strings";
+
+  // Modifications of the original are not visible in the duplicate.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, indices[2])))
+      << "Could not remove key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i64(info, indices[3], -3)))
+      << "Could not set long value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(copy, indices[2], &value)))
+      << "Key removed from original is missing in duplicate";
+  ASSERT_EQ(value, 2) << "Duplicate changed by original";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(copy, indices[3], &value)))
+      << "Could not get long value";
+  ASSERT_EQ(value, 3) << "Duplicate changed by original";
+
+  // A duplicate of a duplicate stays valid after its source is freed.
+  QInfo copy2{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(copy, &copy2)))
+      << "Could not duplicate info";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Free failed";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_compact(info))) << "Could not compact";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(copy2, indices[0], &value)))
+      << "Could not get long value";
+  ASSERT_EQ(value, -1) << "Values do not match";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_peek_val_c(copy2, backend, &peeked, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(peeked, device2) << "Values do not match";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_query(copy2, "calibration.key_299", &index)))
+      << "Could not query shared key";
+  ASSERT_EQ(index, indices[299]) << "Different indices for the same key";
+
+  std::size_t count = 0;
+  for (QInfo_iterator it = QInfo_begin(copy2); it < QInfo_end(copy2);
+       QInfo_next(copy2, &it)) {
+    ++count;
+  }
+  ASSERT_EQ(count, num_keys + 1) << "Wrong number of iterated entries";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy2))) << "Free failed";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(info, indices[4], &value)))
+      << "Could not get long value";
+  ASSERT_EQ(value, 4) << "Original changed by freeing duplicates";
+}
+
+TEST_F(QInfoTest, freezeAndQueryFrozen) {
+  constexpr std::size_t num_keys = 1000;
+  std::vector<QInfo_index> indices(num_keys);
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    const std::string key = "qubit." + std::to_string(i) + ".t1";
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_DOUBLE, &indices[i])))
+        << "Could not add key";
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_set_d(info, indices[i], static_cast<double>(i) / 2)))
+        << "Could not set double value";
+  }
+  QInfo_index index{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "shots", QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i32(info, index, 1000)))
+      << "Could not set int value";
+  const std::string backend = "superconducting-device";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "backend", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, backend.c_str())))
+      << "Could not set string value";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "unset", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+
+  QInfo_frozen frozen{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_freeze(info, &frozen)))
+      << "Could not freeze info";
+  // The frozen object does not depend on its source.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, indices[0])))
+      << "Could not remove key";
+  ASSERT_EQ(QInfo_frozen_size(frozen), static_cast<int>(num_keys + 3))
+      << "Wrong number of entries";
+
+  std::vector<bool> seen(num_keys + 3);
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    const std::string key = "qubit." + std::to_string(i) + ".t1";
+    ASSERT_TRUE(
+        QInfo_is_Success(QInfo_frozen_query(frozen, key.c_str(), &index)))
+        << "Could not query key";
+    ASSERT_FALSE(seen[static_cast<std::size_t>(index)])
+        << "Two keys share an index";
+    seen[static_cast<std::size_t>(index)] = true;
+    double value{};
+    ASSERT_TRUE(
+        QInfo_is_Success(QInfo_frozen_get_val_d(frozen, index, &value)))
+        << "Could not get double value";
+    ASSERT_EQ(value, static_cast<double>(i) / 2) << "Values do not match";
+    const char *peeked{};
+    std::size_t length{};
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_frozen_peek_key(frozen, index, &peeked, &length)))
+        << "Could not peek key";
+    ASSERT_EQ(std::string(peeked, length), key) << "Keys do not match";
+  }
+
+  QInfo_key key{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_key_make("shots", 5, &key)))
+      << "Could not make key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_query_key(frozen, &key, &index)))
+      << "Could not query key";
+  int32_t shots{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_get_val_i32(frozen, index, &shots)))
+      << "Could not get int value";
+  ASSERT_EQ(shots, 1000) << "Values do not match";
+  ASSERT_EQ(QInfo_frozen_get_val_d(frozen, index, nullptr),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Should not be able to get double value of int key";
+
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_frozen_query_n(frozen, "backend!", 7, &index)))
+      << "Could not query key";
+  const char *value{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_frozen_peek_val_c(frozen, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(value, backend) << "Values do not match";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_query(frozen, "unset", &index)))
+      << "Could not query key";
+  std::size_t length{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_frozen_peek_val_c(frozen, index, &value, &length)))
+      << "Could not peek unset string value";
+  ASSERT_EQ(value, nullptr) << "Unset string value should be null";
+  ASSERT_EQ(length, 0) << "Unset string value should be empty";
+
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_frozen_query(frozen, "qubit.1000.t1",
+                                                  &index)))
+      << "Should not find missing key";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_frozen_query(frozen, "", &index)))
+      << "Should not find missing key";
+  ASSERT_TRUE(QInfo_is_Error(
+      QInfo_frozen_get_val_i32(frozen, QInfo_frozen_size(frozen), &shots)))
+      << "Should not be able to get value out of bounds";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_free(frozen))) << "Free failed";
+
+  QInfo empty{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&empty))) << "Creation failed";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_freeze(empty, &frozen)))
+      << "Could not freeze empty info";
+  ASSERT_EQ(QInfo_frozen_size(frozen), 0) << "Frozen info should be empty";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_frozen_query(frozen, "shots", &index)))
+      << "Should not find key in empty frozen info";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_free(frozen))) << "Free failed";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(empty))) << "Free failed";
+}
+
+TEST(QInfoConcurrentTest, parallelReadersAndWriter) {
+  constexpr int num_stable = 100;
+  constexpr int num_rounds = 2000;
+  QInfo info{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create_concurrent(&info)))
+      << "Creation failed";
+  for (int i = 0; i < num_stable; ++i) {
+    const std::string key = "stable." + std::to_string(i);
+    QInfo_index index{};
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_INT64, &index)))
+        << "Could not add key";
+    ASSERT_TRUE(QInfo_is_Success(QInfo_set_i64(info, index, i)))
+        << "Could not set long value";
+  }
+
+  // The writer keeps growing and shrinking the object while the readers look
+  // up the stable keys, so that every read races with reallocations.
+  std::thread writer([info] {
+    for (int round = 0; round < num_rounds; ++round) {
+      const std::string key = "transient." + std::to_string(round);
+      QInfo_index index{};
+      if (QInfo_is_Success(
+              QInfo_add(info, key.c_str(), QINFO_TYPE_STRING, &index))) {
+        QInfo_set_c(info, index, "a value too long to be stored inline");
+        if (round % 2 == 0) {
+          QInfo_remove(info, index);
+        }
+      }
+    }
+  });
+  std::vector<int> failures(4);
+  std::vector<std::thread> readers;
+  for (std::size_t r = 0; r < failures.size(); ++r) {
+    readers.emplace_back([info, r, &failures] {
+      for (int round = 0; round < num_rounds; ++round) {
+        const int i = round % num_stable;
+        const std::string key = "stable." + std::to_string(i);
+        QInfo_index index{};
+        int64_t value{};
+        if (!QInfo_is_Success(QInfo_query(info, key.c_str(), &index)) ||
+            !QInfo_is_Success(QInfo_get_val_i64(info, index, &value)) ||
+            value != i) {
+          ++failures[r];
+        }
+      }
+    });
+  }
+  writer.join();
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  for (const int count : failures) {
+    ASSERT_EQ(count, 0) << "Readers observed wrong values";
+  }
+  QInfo_index index{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "transient.1", &index)))
+      << "Could not query key";
+  char *value{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_c(info, index, &value)))
+      << "Could not get string value";
+  ASSERT_STREQ(value, "a value too long to be stored inline")
+      << "Values do not match";
+  free(value); // NOLINT(*-owning-memory, *-no-malloc)
+
+  QInfo copy{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate info";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Free failed";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "stable.7", &index)))
+      << "Could not query key in duplicate";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Free failed";
+}
+
+TEST(QInfoConcurrentTest, atomicUpdates) {
+  constexpr int num_threads = 4;
+  constexpr int num_rounds = 10000;
+  QInfo info{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create_concurrent(&info)))
+      << "Creation failed";
+  QInfo_index shots{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "shots", QINFO_TYPE_INT64, &shots)))
+      << "Could not add key";
+  QInfo_index retries{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "retries", QINFO_TYPE_INT32, &retries)))
+      << "Could not add key";
+  QInfo_index runtime{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "runtime", QINFO_TYPE_DOUBLE, &runtime)))
+      << "Could not add key";
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([info, shots, retries, runtime] {
+      for (int round = 0; round < num_rounds; ++round) {
+        QInfo_fetch_add_i64(info, shots, 2, nullptr);
+        QInfo_fetch_add_i32(info, retries, 1, nullptr);
+        double expected{};
+        QInfo_load_d(info, runtime, &expected);
+        while (QInfo_compare_exchange_d(info, runtime, &expected,
+                                        expected + 0.5) ==
+               QINFO_WARN_MISMATCH) {
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  int64_t num_shots{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_load_i64(info, shots, &num_shots)))
+      << "Could not load long value";
+  ASSERT_EQ(num_shots, 2 * num_threads * num_rounds) << "Lost updates";
+  int32_t num_retries{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i32(info, retries, &num_retries)))
+      << "Could not get int value";
+  ASSERT_EQ(num_retries, num_threads * num_rounds) << "Lost updates";
+  double total{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_load_d(info, runtime, &total)))
+      << "Could not load double value";
+  ASSERT_EQ(total, 0.5 * num_threads * num_rounds) << "Lost updates";
+
+  int32_t expected = 0;
+  ASSERT_EQ(QInfo_compare_exchange_i32(info, retries, &expected, 7),
+            QINFO_WARN_MISMATCH)
+      << "Exchange should fail on a different value";
+  ASSERT_EQ(expected, num_threads * num_rounds)
+      << "Failed exchange should return the actual value";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_compare_exchange_i32(info, retries, &expected, 7)))
+      << "Exchange should succeed on the expected value";
+  int64_t previous{};
+  ASSERT_EQ(QInfo_fetch_add_i64(info, retries, 1, &previous),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Should not be able to add to an int value as long";
+
+  // Atomic updates of a duplicate do not leak into the original.
+  QInfo copy{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate info";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_fetch_add_i64(copy, shots, 1, &previous)))
+      << "Could not add to long value";
+  ASSERT_EQ(previous, num_shots) << "Values do not match";
+  ASSERT_EQ(QInfo_store_f(info, runtime, 1.0F), QINFO_ERROR_INVALIDTYPE)
+      << "Should not be able to store a float into a double value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_store_d(info, runtime, 1.0)))
+      << "Could not store double value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_load_i64(info, shots, &previous)))
+      << "Could not load long value";
+  ASSERT_EQ(previous, num_shots) << "Duplicate modified the original";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_load_d(copy, runtime, &total)))
+      << "Could not load double value";
+  ASSERT_EQ(total, 0.5 * num_threads * num_rounds)
+      << "Original modified the duplicate";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Free failed";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Free failed";
+}
+
+TEST_F(QInfoTest, serializeRoundTrip) {
+  QInfo_index index{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "shots", QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i32(info, index, -1024)))
+      << "Could not set int value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(info, "device.calibration.timestamp",
+                                         QINFO_TYPE_INT64, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i64(info, index, INT64_MIN + 1)))
+      << "Could not set long value";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "fidelity", QINFO_TYPE_FLOAT, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_f(info, index, 0.999F)))
+      << "Could not set float value";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "t1", QINFO_TYPE_DOUBLE, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_d(info, index, 1.25e-4)))
+      << "Could not set double value";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "backend", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+  const std::string backend(100, 'x');
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, backend.c_str())))
+      << "Could not set string value";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "unset", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "removed", QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, index)))
+      << "Could not remove key";
+
+  std::size_t size{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_serialize(info, nullptr, 0, &size)))
+      << "Could not query serialized size";
+  std::vector<unsigned char> buffer(size);
+  ASSERT_EQ(QInfo_serialize(info, buffer.data(), size - 1, &size),
+            QINFO_ERROR_OUTOFBOUNDS)
+      << "Should not serialize into a buffer that is too small";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_serialize(info, buffer.data(), size, &size)))
+      << "Could not serialize info";
+  // The header is fixed: magic, version 1, no flags, 6 entries.
+  ASSERT_EQ(std::string(buffer.begin(), buffer.begin() + 4), "QINF")
+      << "Wrong magic number";
+  ASSERT_EQ(buffer[4], 1) << "Wrong version";
+  ASSERT_EQ(buffer[8], 6) << "Wrong number of entries";
+
+  QInfo copy{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_deserialize(buffer.data(), buffer.size(), &copy)))
+      << "Could not deserialize info";
+  int32_t shots{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "shots", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i32(copy, index, &shots)))
+      << "Could not get int value";
+  ASSERT_EQ(shots, -1024) << "Values do not match";
+  int64_t timestamp{};
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_query(copy, "device.calibration.timestamp", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(copy, index, &timestamp)))
+      << "Could not get long value";
+  ASSERT_EQ(timestamp, INT64_MIN + 1) << "Values do not match";
+  float fidelity{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "fidelity", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_f(copy, index, &fidelity)))
+      << "Could not get float value";
+  ASSERT_EQ(fidelity, 0.999F) << "Values do not match";
+  double t1{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "t1", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_d(copy, index, &t1)))
+      << "Could not get double value";
+  ASSERT_EQ(t1, 1.25e-4) << "Values do not match";
+  const char *value{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "backend", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(copy, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(value, backend) << "Values do not match";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "unset", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(copy, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(value, nullptr) << "Unset value should stay unset";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_query(copy, "removed", &index)))
+      << "Removed key should not be serialized";
+
+  // Serializing the copy reproduces the same bytes.
+  std::vector<unsigned char> again(size);
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_serialize(copy, again.data(), size, &size)))
+      << "Could not serialize copy";
+  ASSERT_EQ(again, buffer) << "Serialization is not stable";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Free failed";
+
+  // Every truncation and a corrupted header are rejected.
+  for (std::size_t length = 0; length < buffer.size(); ++length) {
+    ASSERT_EQ(QInfo_deserialize(buffer.data(), length, &copy),
+              QINFO_ERROR_INVALIDFORMAT)
+        << "Should reject truncated input";
+  }
+  buffer[4] = 2;
+  ASSERT_EQ(QInfo_deserialize(buffer.data(), buffer.size(), &copy),
+            QINFO_ERROR_INVALIDFORMAT)
+      << "Should reject unknown version";
+}
+
+TEST_F(QInfoTest, openMappedSnapshot) {
+  for (int i = 0; i < 500; ++i) {
+    const std::string key = "coupler." + std::to_string(i) + ".fidelity";
+    QInfo_index index{};
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_FLOAT, &index)))
+        << "Could not add key";
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_set_f(info, index, static_cast<float>(i) / 1000.0F)))
+        << "Could not set float value";
+  }
+  QInfo_index index{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "backend", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_set_c(info, index, "a device with a rather long name")))
+      << "Could not set string value";
+
+  QInfo_frozen frozen{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_freeze(info, &frozen)))
+      << "Could not freeze info";
+  const std::string path = testing::TempDir() + "qinfo_snapshot.bin";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_save(frozen, path.c_str())))
+      << "Could not save snapshot";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_free(frozen))) << "Free failed";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_open_mapped(path.c_str(), &frozen)))
+      << "Could not open snapshot";
+  ASSERT_EQ(QInfo_frozen_size(frozen), 501) << "Wrong number of entries";
+  for (int i = 0; i < 500; ++i) {
+    const std::string key = "coupler." + std::to_string(i) + ".fidelity";
+    ASSERT_TRUE(
+        QInfo_is_Success(QInfo_frozen_query(frozen, key.c_str(), &index)))
+        << "Could not query key";
+    float value{};
+    ASSERT_TRUE(
+        QInfo_is_Success(QInfo_frozen_get_val_f(frozen, index, &value)))
+        << "Could not get float value";
+    ASSERT_EQ(value, static_cast<float>(i) / 1000.0F) << "Values do not match";
+  }
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_query(frozen, "backend", &index)))
+      << "Could not query key";
+  const char *backend{};
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_frozen_peek_val_c(frozen, index, &backend, nullptr)))
+      << "Could not peek string value";
+  ASSERT_STREQ(backend, "a device with a rather long name")
+      << "Values do not match";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_frozen_query(frozen, "missing", &index)))
+      << "Should not find missing key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_frozen_free(frozen))) << "Free failed";
+
+  ASSERT_EQ(QInfo_open_mapped((path + ".missing").c_str(), &frozen),
+            QINFO_ERROR_IO)
+      << "Should not open missing file";
+  FILE *file = fopen(path.c_str(), "r+b");
+  ASSERT_NE(file, nullptr) << "Could not open snapshot for writing";
+  fputc('X', file);
+  fclose(file);
+  ASSERT_EQ(QInfo_open_mapped(path.c_str(), &frozen), QINFO_ERROR_INVALIDFORMAT)
+      << "Should reject file without magic";
+  std::remove(path.c_str());
+}
+
+TEST_F(QInfoTest, loadTextBuffer) {
+  const std::string text = "# device calibration\n"
+                           "shots:i32 = -1024\n"
+                           "\n"
+                           "  calibration.timestamp:i64=9223372036854775807\n"
+                           "qubit.0.fidelity:f32 = 0.5 # trailing comment\n"
+                           "qubit.0.t1:f64 = 1.25e-4\r\n"
+                           "backend:str = "
+                           "\"a \\\"quoted\\\" name\\twith tab\"\n"
+                           "site:str =   Garching Research Campus   # note\n"
+                           "notes:str\n"
+                           "retries:i32";
+  size_t error_line{};
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_load_buffer(info, text.data(), text.size(), &error_line)))
+      << "Could not load text, error in line " << error_line;
+
+  QInfo_index index{};
+  int32_t shots{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "shots", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i32(info, index, &shots)))
+      << "Could not get int value";
+  ASSERT_EQ(shots, -1024) << "Values do not match";
+  int64_t timestamp{};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_query(info, "calibration.timestamp", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(info, index, &timestamp)))
+      << "Could not get long value";
+  ASSERT_EQ(timestamp, INT64_MAX) << "Values do not match";
+  float fidelity{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "qubit.0.fidelity", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_f(info, index, &fidelity)))
+      << "Could not get float value";
+  ASSERT_EQ(fidelity, 0.5F) << "Values do not match";
+  double t1{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "qubit.0.t1", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_d(info, index, &t1)))
+      << "Could not get double value";
+  ASSERT_EQ(t1, 1.25e-4) << "Values do not match";
+  const char *value{};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "backend", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(info, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_STREQ(value, "a \"quoted\" name\twith tab") << "Values do not match";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "site", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(info, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_STREQ(value, "Garching Research Campus") << "Values do not match";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "notes", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(info, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(value, nullptr) << "String without value should be unset";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "retries", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i32(info, index, &shots)))
+      << "Could not get int value";
+  ASSERT_EQ(shots, 0) << "Integer without value should be 0";
+
+  // A failing load adds nothing and reports the line.
+  const std::vector<std::pair<std::string, std::size_t>> invalid = {
+      {"a:i32 = 1\nb:i32 = 2147483648\n", 2},
+      {"a:i32 = 1\nb:i16 = 2\n", 2},
+      {"a:i32 = 1\nb i32 = 2\n", 2},
+      {"a:f64 = 1.0x\n", 1},
+      {"a:str = \"unterminated\n", 1},
+      {"a:i32 = 1 2\n", 1},
+      {"a:i32 = 1\nb:i32 =\n", 2},
+      {"a:i32 = 1\nb:i32 = 2\nshots:i32 = 3\n", 3},
+      {"a:i32 = 1\na:i64 = 2\n", 2}};
+  for (const auto &entry : invalid) {
+    ASSERT_LT(QInfo_load_buffer(info, entry.first.data(), entry.first.size(),
+                                &error_line),
+              QINFO_SUCCESS)
+        << "Should reject " << entry.first;
+    ASSERT_EQ(error_line, entry.second) << "Wrong error line for "
+                                        << entry.first;
+    ASSERT_TRUE(QInfo_is_Warning(QInfo_query(info, "a", &index)))
+        << "Failed load should not add entries";
+  }
+  int count = 0;
+  for (QInfo_iterator it = QInfo_begin(info); it != QInfo_end(info);
+       QInfo_next(info, &it)) {
+    ++count;
+  }
+  ASSERT_EQ(count, 8) << "Failed loads changed the object";
+
+  const std::string path = testing::TempDir() + "qinfo_config.txt";
+  FILE *file = fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr) << "Could not create config file";
+  fputs("from.file:i64 = 42\n", file);
+  fclose(file);
+  ASSERT_TRUE(QInfo_is_Success(QInfo_load_file(info, path.c_str(), nullptr)))
+      << "Could not load file";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "from.file", &index)))
+      << "Could not query key";
+  ASSERT_EQ(QInfo_load_file(info, (path + ".missing").c_str(), nullptr),
+            QINFO_ERROR_IO)
+      << "Should not load missing file";
+  std::remove(path.c_str());
+}
+
+TEST_F(QInfoTest, mergeWithPolicies) {
+  const std::string long_value(100, 'v');
+  QInfo_index index = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(info, "a", QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i32(info, index, 1)))
+      << "Could not set value";
+  const QInfo_index index_a = index;
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "name", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, long_value.c_str())))
+      << "Could not set value";
+
+  QInfo src = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&src))) << "Could not create";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(src, "a", QINFO_TYPE_INT64, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i64(src, index, 2)))
+      << "Could not set value";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(src, "name", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(src, index, "short")))
+      << "Could not set value";
+  for (int i = 0; i < 200; ++i) {
+    const std::string key = "src.key." + std::to_string(i) + long_value;
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(src, key.c_str(), QINFO_TYPE_STRING, &index)))
+        << "Could not add key";
+    ASSERT_TRUE(
+        QInfo_is_Success(QInfo_set_c(src, index, (key + "!").c_str())))
+        << "Could not set value";
+  }
+
+  // Conflicts fail the merge without changes.
+  ASSERT_EQ(QInfo_merge(info, src, QINFO_MERGE_ERROR), QINFO_ERROR_KEYEXISTS)
+      << "Should report conflicting keys";
+  int count = 0;
+  for (QInfo_iterator it = QInfo_begin(info); it != QInfo_end(info);
+       QInfo_next(info, &it)) {
+    ++count;
+  }
+  ASSERT_EQ(count, 2) << "Failed merge changed the object";
+
+  // Existing values are kept.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_merge(info, src, QINFO_MERGE_KEEP)))
+      << "Could not merge";
+  int32_t value_i32 = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i32(info, index_a, &value_i32)))
+      << "Existing entry should keep its type";
+  ASSERT_EQ(value_i32, 1) << "Existing value should be kept";
+
+  // Existing values are overwritten, including their type.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_merge(info, src, QINFO_MERGE_OVERWRITE)))
+      << "Could not merge";
+  int64_t value_i64 = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(info, index_a, &value_i64)))
+      << "Overwritten entry should take the new type";
+  ASSERT_EQ(value_i64, 2) << "Existing value should be overwritten";
+
+  // Merging an object into itself changes nothing.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_merge(src, src, QINFO_MERGE_KEEP)))
+      << "Could not merge object into itself";
+  ASSERT_EQ(QInfo_merge(src, src, QINFO_MERGE_ERROR), QINFO_ERROR_KEYEXISTS)
+      << "Should report conflicting keys";
+
+  // Shared strings stay valid and independent after src changes or is freed.
+  const std::string key0 = "src.key.0" + long_value;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(src, key0.c_str(), &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(src, index, "changed")))
+      << "Could not set value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(src))) << "Could not free";
+
+  count = 0;
+  for (QInfo_iterator it = QInfo_begin(info); it != QInfo_end(info);
+       QInfo_next(info, &it)) {
+    ++count;
+  }
+  ASSERT_EQ(count, 202) << "Wrong number of merged entries";
+  const char *value = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "name", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(info, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_STREQ(value, "short") << "Values do not match";
+  for (int i = 0; i < 200; ++i) {
+    const std::string key = "src.key." + std::to_string(i) + long_value;
+    ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, key.c_str(), &index)))
+        << "Could not query merged key";
+    ASSERT_TRUE(
+        QInfo_is_Success(QInfo_peek_val_c(info, index, &value, nullptr)))
+        << "Could not peek string value";
+    ASSERT_EQ(value, key + "!") << "Values do not match";
+  }
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, index)))
+      << "Could not remove merged entry";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_compact(info))) << "Could not compact";
+}
+
+TEST_F(QInfoTest, layeredLookupAndFlatten) {
+  QInfo_index index = 0;
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "shots", QINFO_TYPE_INT32, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i32(info, index, 1024)))
+      << "Could not set value";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "backend", QINFO_TYPE_STRING, &index)))
+      << "Could not add key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, "default backend")))
+      << "Could not set value";
+
+  QInfo job = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create_layered(info, &job)))
+      << "Could not create layered object";
+  QInfo step = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create_layered(job, &step)))
+      << "Could not create layered object";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(job, "shots", QINFO_TYPE_INT64, &index)))
+      << "Could not add override";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_i64(job, index, 4096)))
+      << "Could not set value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(step, "seed", QINFO_TYPE_INT32,
+                                         &index)))
+      << "Could not add key";
+
+  // Lookups fall back through the chain, and overrides win.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(step, "shots", &index)))
+      << "Could not query inherited key";
+  int64_t shots = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(step, index, &shots)))
+      << "Could not get inherited value";
+  ASSERT_EQ(shots, 4096) << "Override should shadow the root";
+  ASSERT_EQ(QInfo_set_i64(step, index, 1), QINFO_ERROR_OUTOFBOUNDS)
+      << "Inherited entries should not be writable through the child";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(step, "backend", &index)))
+      << "Could not query inherited key";
+  const char *value = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(step, index, &value, nullptr)))
+      << "Could not peek inherited value";
+  ASSERT_STREQ(value, "default backend") << "Values do not match";
+  enum QINFO_TYPE type = QINFO_TYPE_INT32;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_type(step, index, &type)))
+      << "Could not get inherited type";
+  ASSERT_EQ(type, QINFO_TYPE_STRING) << "Types do not match";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_query(step, "missing", &index)))
+      << "Missing key should not be found in any layer";
+
+  // Batch lookups resolve through the chain as well.
+  const char *const keys[] = {"seed", "backend", "missing"};
+  QInfo_index indices[3];
+  ASSERT_EQ(QInfo_query_many(step, 3, keys, indices), QINFO_WARN_NOKEY)
+      << "Missing key should be reported";
+  ASSERT_LT(indices[2], 0) << "Missing key should have no index";
+  const char *values[1];
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_many_c(step, 1, &indices[1], values)))
+      << "Could not peek inherited values";
+  ASSERT_STREQ(values[0], "default backend") << "Values do not match";
+  ASSERT_EQ(QInfo_peek_many_c(step, 2, indices, values),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Should reject mixed types";
+
+  // Parent changes are visible to children.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "backend", &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, "changed")))
+      << "Could not set value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(step, "backend", &index)))
+      << "Could not query inherited key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(step, index, &value, nullptr)))
+      << "Could not peek inherited value";
+  ASSERT_STREQ(value, "changed") << "Child should observe the parent";
+
+  // Flattening resolves all layers into an independent object.
+  QInfo flat = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_flatten(step, &flat)))
+      << "Could not flatten";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(step))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(job))) << "Could not free";
+  int count = 0;
+  for (QInfo_iterator it = QInfo_begin(flat); it != QInfo_end(flat);
+       QInfo_next(flat, &it)) {
+    ++count;
+  }
+  ASSERT_EQ(count, 3) << "Wrong number of flattened entries";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(flat, "shots", &index)))
+      << "Could not query flattened key";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i64(flat, index, &shots)))
+      << "Flattened entry should take the override";
+  ASSERT_EQ(shots, 4096) << "Values do not match";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(flat))) << "Could not free";
+}
+
+TEST(QInfoAllocatorTest, customAllocator) {
+  // Counts live blocks and releases them through malloc and free.
+  struct Counter {
+    int live = 0;
+    int total = 0;
+  } counter;
+  QInfo_allocator counting = {};
+  counting.alloc = [](void *context, std::size_t size) -> void * {
+    auto *count = static_cast<Counter *>(context);
+    ++count->live;
+    ++count->total;
+    return std::malloc(size);
+  };
+  counting.realloc = [](void *, void *ptr, std::size_t,
+                        std::size_t size) -> void * {
+    return std::realloc(ptr, size);
+  };
+  counting.free = [](void *context, void *ptr) {
+    --static_cast<Counter *>(context)->live;
+    std::free(ptr);
+  };
+  counting.context = &counter;
+
+  QInfo info = nullptr;
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_create_with_allocator(&info, 4, &counting)))
+      << "Could not create with allocator";
+  const std::string long_value(100, 'x');
+  QInfo_index index = 0;
+  for (int i = 0; i < 1000; ++i) {
+    const std::string key = "key." + std::to_string(i) + long_value;
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_STRING, &index)))
+        << "Could not add key";
+    ASSERT_TRUE(QInfo_is_Success(QInfo_set_c(info, index, key.c_str())))
+        << "Could not set value";
+  }
+  const int after_adds = counter.total;
+  ASSERT_GT(after_adds, 0) << "Allocator was not used";
+
+  // Duplicates use the same allocator, and merged strings stay alive until
+  // the last object referencing them is freed.
+  QInfo copy = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(copy, index)))
+      << "Could not remove";
+  ASSERT_GT(counter.total, after_adds) << "Duplicate should use allocator";
+  QInfo other = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&other))) << "Could not create";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_merge(other, info, QINFO_MERGE_ERROR)))
+      << "Could not merge";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Could not free";
+  ASSERT_GT(counter.live, 0) << "Merged strings were released too early";
+  const std::string key0 = "key.0" + long_value;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(other, key0.c_str(), &index)))
+      << "Could not query merged key";
+  const char *value = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(other, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(value, key0) << "Values do not match";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(other))) << "Could not free";
+  ASSERT_EQ(counter.live, 0) << "Not all blocks were released";
+
+  // An allocator without realloc and free, whose blocks are dropped in bulk.
+  std::vector<void *> blocks;
+  QInfo_allocator bulk = {};
+  bulk.alloc = [](void *context, std::size_t size) -> void * {
+    void *block = std::malloc(size);
+    static_cast<std::vector<void *> *>(context)->push_back(block);
+    return block;
+  };
+  bulk.context = &blocks;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create_with_allocator(&info, 1, &bulk)))
+      << "Could not create with allocator";
+  for (int i = 0; i < 500; ++i) {
+    const std::string key = "bulk." + std::to_string(i) + long_value;
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_INT32, &index)))
+        << "Could not add key";
+    ASSERT_TRUE(QInfo_is_Success(QInfo_set_i32(info, index, i)))
+        << "Could not set value";
+  }
+  const std::string key499 = "bulk.499" + long_value;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, key499.c_str(), &index)))
+      << "Could not query key";
+  int32_t number = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_i32(info, index, &number)))
+      << "Could not get value";
+  ASSERT_EQ(number, 499) << "Values do not match";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Could not free";
+  for (void *block : blocks) {
+    std::free(block);
+  }
+}
+
+TEST(QInfoAllocatorTest, failedTextLoadAddsNothing) {
+  // Fails every allocation once armed.
+  bool fail = false;
+  QInfo_allocator failing = {};
+  failing.alloc = [](void *context, std::size_t size) -> void * {
+    return *static_cast<bool *>(context) ? nullptr : std::malloc(size);
+  };
+  failing.free = [](void *, void *ptr) { std::free(ptr); };
+  failing.context = &fail;
+
+  QInfo info = nullptr;
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_create_with_allocator(&info, 16, &failing)))
+      << "Could not create with allocator";
+
+  // The short keys fit inline and the slots are reserved, so only the long
+  // string value of the second line needs memory.
+  const std::string text = "a:i32 = 1\nb:str = " + std::string(10000, 'x');
+  fail = true;
+  std::size_t error_line = 0;
+  ASSERT_EQ(QInfo_load_buffer(info, text.data(), text.size(), &error_line),
+            QINFO_ERROR_OUTOFMEM)
+      << "Allocation failure not reported";
+  fail = false;
+  ASSERT_EQ(error_line, 2U) << "Wrong error line";
+  ASSERT_TRUE(QInfo_empty(info)) << "Failed load should add nothing";
+  QInfo_index index = 0;
+  ASSERT_EQ(QInfo_query(info, "b", &index), QINFO_WARN_NOKEY)
+      << "Entry of the failing line was left behind";
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_load_buffer(info, text.data(), text.size(), &error_line)))
+      << "Could not load after the failure";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Could not free";
+}
+
+TEST(QInfoPoolTest, clearAndRecycle) {
+  // Counts allocations to check that a cleared object is refilled in place.
+  int allocations = 0;
+  QInfo_allocator counting = {};
+  counting.alloc = [](void *context, std::size_t size) -> void * {
+    ++*static_cast<int *>(context);
+    return std::malloc(size);
+  };
+  counting.free = [](void *, void *ptr) { std::free(ptr); };
+  counting.context = &allocations;
+
+  QInfo info = nullptr;
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_create_with_allocator(&info, 1, &counting)))
+      << "Could not create with allocator";
+  const std::string long_value(60, 'v');
+  const auto fill = [&](QInfo target) {
+    for (int i = 0; i < 300; ++i) {
+      const std::string key = "job.key." + std::to_string(i);
+      QInfo_index index = 0;
+      ASSERT_TRUE(QInfo_is_Success(
+          QInfo_add(target, key.c_str(), QINFO_TYPE_STRING, &index)))
+          << "Could not add key";
+      ASSERT_TRUE(QInfo_is_Success(
+          QInfo_set_c(target, index, (key + long_value).c_str())))
+          << "Could not set value";
+    }
+  };
+  fill(info);
+  ASSERT_TRUE(QInfo_is_Success(QInfo_clear(info))) << "Could not clear";
+  ASSERT_TRUE(QInfo_empty(info)) << "Cleared object should be empty";
+  QInfo_index index = 0;
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_query(info, "job.key.0", &index)))
+      << "Cleared key should not be found";
+  fill(info);
+  ASSERT_TRUE(QInfo_is_Success(QInfo_clear(info))) << "Could not clear";
+  const int warm = allocations;
+  fill(info);
+  ASSERT_EQ(allocations, warm) << "Refilling should not allocate";
+
+  // Clearing does not affect a duplicate sharing the storage.
+  QInfo copy = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_clear(info))) << "Could not clear";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "job.key.299", &index)))
+      << "Duplicate should keep its entries";
+  const char *value = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_val_c(copy, index, &value, nullptr)))
+      << "Could not peek string value";
+  ASSERT_EQ(value, "job.key.299" + long_value) << "Values do not match";
+  fill(info);
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Could not free";
+
+  // Released objects are handed out again, empty.
+  QInfo first = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_acquire(&first))) << "Could not acquire";
+  fill(first);
+  ASSERT_TRUE(QInfo_is_Success(QInfo_release(first))) << "Could not release";
+  QInfo second = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_acquire(&second))) << "Could not acquire";
+  ASSERT_EQ(second, first) << "Released object should be recycled";
+  ASSERT_TRUE(QInfo_empty(second)) << "Recycled object should be empty";
+  fill(second);
+  ASSERT_TRUE(QInfo_is_Success(QInfo_release(second))) << "Could not release";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_pool_drain())) << "Could not drain";
+}
+
+TEST(QInfoStatsTest, footprintAndCounters) {
+  QInfo info = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&info))) << "Could not create";
+  QInfo_stats empty;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_stats(info, &empty)))
+      << "Could not get stats";
+  ASSERT_GT(empty.live_bytes, 0U) << "Empty object should hold storage";
+  ASSERT_EQ(empty.shared_bytes, 0U) << "Nothing should be shared";
+
+  for (int i = 0; i < 1000; ++i) {
+    const std::string key = "stats.key.with.a.long.name." + std::to_string(i);
+    QInfo_index index = 0;
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_INT32, &index)))
+        << "Could not add key";
+  }
+  QInfo_index index = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "stats.key.with.a.long.name.7",
+                                           &index)))
+      << "Could not query key";
+  ASSERT_TRUE(QInfo_is_Warning(QInfo_query(info, "stats.missing", &index)))
+      << "Missing key should not be found";
+
+  QInfo_stats full;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_stats(info, &full)))
+      << "Could not get stats";
+  ASSERT_GT(full.live_bytes, empty.live_bytes + 1000 * sizeof(int))
+      << "Footprint should grow with the entries";
+  ASSERT_GE(full.peak_bytes, full.live_bytes) << "Peak below live bytes";
+
+  // A duplicate shares all storage with the original.
+  QInfo copy = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate";
+  QInfo_stats dup;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_stats(copy, &dup)))
+      << "Could not get stats";
+  ASSERT_GT(dup.shared_bytes, dup.live_bytes / 2)
+      << "Duplicate should share most of its storage";
+
+  if (full.instrumented) {
+    ASSERT_EQ(full.lookups, full.hits + full.misses) << "Lookups do not add up";
+    ASSERT_GE(full.lookups, 1002U) << "Adds and queries should be counted";
+    ASSERT_GE(full.hits, 1U) << "Hit should be counted";
+    ASSERT_GE(full.misses, 1001U) << "Misses should be counted";
+    ASSERT_GE(full.probes, full.lookups) << "Every lookup probes a bucket";
+    ASSERT_GE(full.max_probe, 1U) << "Longest probe should be recorded";
+    ASSERT_GT(full.growths, 0U) << "Growth should be counted";
+    ASSERT_GT(full.allocations, 0U) << "Allocations should be counted";
+    ASSERT_GT(full.peak_bytes, empty.live_bytes) << "Peak should grow";
+    ASSERT_EQ(dup.lookups, 0U) << "Duplicate should start with no lookups";
+  } else {
+    ASSERT_EQ(full.lookups, 0U) << "Counters should be zero";
+    ASSERT_EQ(full.allocations, 0U) << "Counters should be zero";
+  }
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Could not free";
+}
+
+TEST(QInfoProfileTest, hotKeysAndOptimize) {
+  QInfo info = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&info))) << "Could not create";
+  const size_t num_keys = 3000;
+  std::vector<QInfo_index> indices(num_keys);
+  for (size_t i = 0; i < num_keys; ++i) {
+    const std::string key = "calibration.qubit." + std::to_string(i);
+    ASSERT_TRUE(QInfo_is_Success(
+        QInfo_add(info, key.c_str(), QINFO_TYPE_INT64, &indices[i])))
+        << "Could not add key";
+  }
+  ASSERT_TRUE(QInfo_is_Success(QInfo_profile(info, 1)))
+      << "Could not start profiling";
+
+  // Three hot keys with distinct frequencies, added after profiling started
+  // so that the value space has to grow.
+  const char *hot[] = {"shots", "qubits", "device"};
+  for (const char *key : hot) {
+    QInfo_index index = 0;
+    ASSERT_TRUE(
+        QInfo_is_Success(QInfo_add(info, key, QINFO_TYPE_INT64, &index)))
+        << "Could not add key";
+  }
+  QInfo_index index = 0;
+  for (int round = 0; round < 100; ++round) {
+    for (int k = 0; k < 3; ++k) {
+      for (int r = 0; r < 3 - k; ++r) {
+        ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, hot[k], &index)))
+            << "Could not query hot key";
+      }
+    }
+  }
+  for (size_t i = 0; i < num_keys; i += 7) {
+    const std::string key = "calibration.qubit." + std::to_string(i);
+    ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, key.c_str(), &index)))
+        << "Could not query key";
+  }
+
+  QInfo_index top[4];
+  uint64_t counts[4];
+  size_t count = 0;
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_get_hot_keys(info, 4, top, counts, &count)))
+      << "Could not get hot keys";
+  ASSERT_EQ(count, 4U) << "Unexpected number of hot keys";
+  for (size_t k = 0; k < 3; ++k) {
+    const char *key = nullptr;
+    ASSERT_TRUE(QInfo_is_Success(QInfo_peek_key(info, top[k], &key, nullptr)))
+        << "Could not peek key";
+    ASSERT_STREQ(key, hot[k]) << "Hot keys in wrong order";
+    ASSERT_EQ(counts[k], 100U * (3 - k)) << "Unexpected lookup count";
+  }
+  ASSERT_EQ(counts[3], 1U) << "Cold key should be counted once";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_optimize(info))) << "Could not optimize";
+  for (size_t i = 0; i < num_keys; ++i) {
+    const std::string key = "calibration.qubit." + std::to_string(i);
+    ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, key.c_str(), &index)))
+        << "Key lost by optimize";
+    ASSERT_EQ(index, indices[i]) << "Optimize must keep indices";
+  }
+  QInfo_stats before;
+  QInfo_stats after;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_stats(info, &before)))
+      << "Could not get stats";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(info, "shots", &index)))
+      << "Could not query hot key";
+  ASSERT_EQ(index, top[0]) << "Optimize must keep indices";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_stats(info, &after)))
+      << "Could not get stats";
+  if (after.instrumented) {
+    ASSERT_EQ(after.probes - before.probes, 1U)
+        << "Hottest key should sit in its home bucket";
+  }
+
+  // Removed keys are forgotten, duplicates are not profiled.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, top[0])))
+      << "Could not remove";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_get_hot_keys(info, 1, top, counts, &count)))
+      << "Could not get hot keys";
+  ASSERT_EQ(count, 1U) << "Unexpected number of hot keys";
+  ASSERT_EQ(counts[0], 200U) << "Removed key should be forgotten";
+  QInfo copy = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_get_hot_keys(copy, 1, top, counts, &count)))
+      << "Could not get hot keys";
+  ASSERT_EQ(count, 0U) << "Duplicate should not be profiled";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_profile(info, 0)))
+      << "Could not stop profiling";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_get_hot_keys(info, 1, top, counts, &count)))
+      << "Could not get hot keys";
+  ASSERT_EQ(count, 0U) << "Stopped profile should be discarded";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Could not free";
+}
+
+TEST(QInfoArrayTest, contiguousArrays) {
+  QInfo info = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&info))) << "Could not create";
+
+  QInfo_index ia = 0, la = 0, fa = 0, da = 0, scalar = 0;
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_add(info, "shots", QINFO_TYPE_INT32_ARRAY, &ia)))
+      << "Could not add";
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_add(info, "seeds", QINFO_TYPE_INT64_ARRAY, &la)))
+      << "Could not add";
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_add(info, "angles", QINFO_TYPE_FLOAT_ARRAY, &fa)))
+      << "Could not add";
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_add(info, "errors", QINFO_TYPE_DOUBLE_ARRAY, &da)))
+      << "Could not add";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "qubits", QINFO_TYPE_INT32, &scalar)))
+      << "Could not add";
+
+  const double *dv = nullptr;
+  size_t count = 1;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_d(info, da, &dv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, 0U) << "New arrays should be empty";
+
+  std::vector<int32_t> shots(100);
+  std::vector<double> errors(37);
+  for (size_t i = 0; i < shots.size(); ++i) {
+    shots[i] = static_cast<int32_t>(i) * 3;
+  }
+  for (size_t i = 0; i < errors.size(); ++i) {
+    errors[i] = 0.5 / static_cast<double>(i + 1);
+  }
+  const int64_t seeds[] = {INT64_MIN, -1, INT64_MAX};
+  const float angles[] = {0.25f, -1.5f};
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_set_array_i32(info, ia, shots.data(), shots.size())))
+      << "Could not set";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_array_i64(info, la, seeds, 3)))
+      << "Could not set";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_array_f(info, fa, angles, 2)))
+      << "Could not set";
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_set_array_d(info, da, errors.data(), errors.size())))
+      << "Could not set";
+
+  const int32_t *iv = nullptr;
+  const int64_t *lv = nullptr;
+  const float *fv = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_i32(info, ia, &iv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, shots.size()) << "Unexpected count";
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(iv) % 64, 0U) << "Array not aligned";
+  ASSERT_TRUE(std::equal(shots.begin(), shots.end(), iv)) << "Wrong elements";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_i64(info, la, &lv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, 3U) << "Unexpected count";
+  ASSERT_TRUE(std::equal(seeds, seeds + 3, lv)) << "Wrong elements";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_f(info, fa, &fv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, 2U) << "Unexpected count";
+  ASSERT_TRUE(std::equal(angles, angles + 2, fv)) << "Wrong elements";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_d(info, da, &dv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, errors.size()) << "Unexpected count";
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(dv) % 64, 0U) << "Array not aligned";
+  ASSERT_TRUE(std::equal(errors.begin(), errors.end(), dv))
+      << "Wrong elements";
+
+  // Wrong types are rejected both ways.
+  ASSERT_EQ(QInfo_peek_array_d(info, ia, &dv, &count),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Type mismatch not detected";
+  ASSERT_EQ(QInfo_peek_array_i32(info, scalar, &iv, &count),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Type mismatch not detected";
+  int32_t value = 0;
+  ASSERT_EQ(QInfo_get_val_i32(info, ia, &value), QINFO_ERROR_INVALIDTYPE)
+      << "Type mismatch not detected";
+
+  // A duplicate keeps its elements when the original is overwritten in place
+  // or resized.
+  QInfo copy = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate";
+  const int32_t first[] = {7, 8, 9};
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_array_i32(info, ia, first, 3)))
+      << "Could not set";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_array_d(info, da, dv, 36)))
+      << "Could not set from a view";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_d(info, da, &dv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, 36U) << "Unexpected count";
+  ASSERT_TRUE(std::equal(errors.begin(), errors.begin() + 36, dv))
+      << "Wrong elements";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_i32(copy, ia, &iv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, shots.size()) << "Duplicate changed";
+  ASSERT_TRUE(std::equal(shots.begin(), shots.end(), iv))
+      << "Duplicate changed";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_array_f(info, fa, nullptr, 0)))
+      << "Could not clear";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_f(info, fa, &fv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, 0U) << "Array not cleared";
+
+  // Compaction, serialization and merges keep the elements.
+  ASSERT_TRUE(QInfo_is_Success(QInfo_compact(info))) << "Could not compact";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_i32(info, ia, &iv, &count)))
+      << "Could not peek";
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(iv) % 64, 0U) << "Array not aligned";
+  ASSERT_TRUE(std::equal(first, first + 3, iv)) << "Compact lost elements";
+  ASSERT_EQ(count, 3U) << "Compact lost elements";
+
+  size_t size = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_serialize(info, nullptr, 0, &size)))
+      << "Could not size";
+  std::vector<char> buffer(size);
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_serialize(info, buffer.data(), buffer.size(), &size)))
+      << "Could not serialize";
+  QInfo loaded = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_deserialize(buffer.data(), buffer.size(), &loaded)))
+      << "Could not deserialize";
+  QInfo_index index = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(loaded, "seeds", &index)))
+      << "Could not query";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_i64(loaded, index, &lv,
+                                                    &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, 3U) << "Unexpected count";
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(lv) % 64, 0U) << "Array not aligned";
+  ASSERT_TRUE(std::equal(seeds, seeds + 3, lv)) << "Wrong elements";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(loaded, "errors", &index)))
+      << "Could not query";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_d(loaded, index, &dv,
+                                                  &count)))
+      << "Could not peek";
+  ASSERT_TRUE(std::equal(errors.begin(), errors.begin() + 36, dv))
+      << "Wrong elements";
+  ASSERT_EQ(QInfo_deserialize(buffer.data(), buffer.size() - 1, &copy),
+            QINFO_ERROR_INVALIDFORMAT)
+      << "Truncated buffer not detected";
+
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_merge(copy, loaded, QINFO_MERGE_OVERWRITE)))
+      << "Could not merge";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(loaded))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "shots", &index)))
+      << "Could not query";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_array_i32(copy, index, &iv,
+                                                    &count)))
+      << "Could not peek";
+  ASSERT_EQ(count, 3U) << "Merge lost elements";
+  ASSERT_TRUE(std::equal(first, first + 3, iv)) << "Merge lost elements";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(copy, index)))
+      << "Could not remove";
+
+  QInfo_frozen frozen = nullptr;
+  ASSERT_EQ(QInfo_freeze(info, &frozen), QINFO_ERROR_INVALIDTYPE)
+      << "Arrays cannot be frozen";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Could not free";
+}
+
+TEST(QInfoBlobTest, lengthDelimitedBytes) {
+  QInfo info = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&info))) << "Could not create";
+
+  QInfo_index blob = 0, str = 0;
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "envelope", QINFO_TYPE_BLOB, &blob)))
+      << "Could not add";
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_add(info, "name", QINFO_TYPE_STRING, &str)))
+      << "Could not add";
+
+  const void *data = nullptr;
+  size_t size = 1;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_blob(info, blob, &data, &size)))
+      << "Could not peek";
+  ASSERT_EQ(data, nullptr) << "New blobs should be empty";
+  ASSERT_EQ(size, 0U) << "New blobs should be empty";
+
+  // Payloads may contain zero bytes anywhere.
+  std::vector<unsigned char> payload(1000);
+  for (size_t i = 0; i < payload.size(); ++i) {
+    payload[i] = static_cast<unsigned char>(i % 7 == 0 ? 0 : i * 31);
+  }
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_set_blob(info, blob, payload.data(), payload.size())))
+      << "Could not set";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_blob(info, blob, &data, &size)))
+      << "Could not peek";
+  ASSERT_EQ(size, payload.size()) << "Unexpected size";
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(data) % 64, 0U) << "Blob not aligned";
+  ASSERT_EQ(memcmp(data, payload.data(), size), 0) << "Wrong bytes";
+  ASSERT_EQ(QInfo_peek_blob(info, str, &data, &size),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Type mismatch not detected";
+  ASSERT_EQ(QInfo_set_blob(info, str, payload.data(), 1),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Type mismatch not detected";
+
+  QInfo copy = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(info, &copy)))
+      << "Could not duplicate";
+  const char packed[] = {'\x01', '\0', '\x02', '\0', '\x03'};
+  ASSERT_TRUE(
+      QInfo_is_Success(QInfo_set_blob(info, blob, packed, sizeof(packed))))
+      << "Could not set";
+
+  size_t bytes = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_serialize(info, nullptr, 0, &bytes)))
+      << "Could not size";
+  std::vector<char> buffer(bytes);
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_serialize(info, buffer.data(), buffer.size(), &bytes)))
+      << "Could not serialize";
+  QInfo loaded = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_deserialize(buffer.data(), buffer.size(), &loaded)))
+      << "Could not deserialize";
+  QInfo_index index = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(loaded, "envelope", &index)))
+      << "Could not query";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_blob(loaded, index, &data, &size)))
+      << "Could not peek";
+  ASSERT_EQ(size, sizeof(packed)) << "Unexpected size";
+  ASSERT_EQ(memcmp(data, packed, size), 0) << "Wrong bytes";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(loaded))) << "Could not free";
+
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_blob(copy, blob, &data, &size)))
+      << "Could not peek";
+  ASSERT_EQ(size, payload.size()) << "Duplicate changed";
+  ASSERT_EQ(memcmp(data, payload.data(), size), 0) << "Duplicate changed";
+
+  QInfo_frozen frozen = nullptr;
+  ASSERT_EQ(QInfo_freeze(info, &frozen), QINFO_ERROR_INVALIDTYPE)
+      << "Blobs cannot be frozen";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_blob(info, blob, nullptr, 0)))
+      << "Could not clear";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(info, blob)))
+      << "Could not remove";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(info))) << "Could not free";
+}
+
+TEST(QInfoNestedTest, childrenAndPaths) {
+  QInfo root = nullptr;
+  QInfo device = nullptr;
+  QInfo qubit = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&root))) << "Could not create";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&device))) << "Could not create";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_create(&qubit))) << "Could not create";
+
+  QInfo_index index = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(qubit, "t1", QINFO_TYPE_DOUBLE,
+                                         &index)))
+      << "Could not add";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_d(qubit, index, 85.5)))
+      << "Could not set";
+  QInfo_index slot = 0;
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_add(device, "qubit_17", QINFO_TYPE_QINFO, &slot)))
+      << "Could not add";
+  QInfo child = root;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_child(device, slot, &child)))
+      << "Could not peek";
+  ASSERT_EQ(child, nullptr) << "New entries should hold no object";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_child(device, slot, qubit)))
+      << "Could not nest";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(device, "unset", QINFO_TYPE_QINFO,
+                                         &index)))
+      << "Could not add";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(root, "device", QINFO_TYPE_QINFO,
+                                         &slot)))
+      << "Could not add";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_child(root, slot, device)))
+      << "Could not nest";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(root, "name", QINFO_TYPE_STRING,
+                                         &index)))
+      << "Could not add";
+
+  // Nesting must form a tree.
+  ASSERT_EQ(QInfo_free(qubit), QINFO_ERROR_INVALIDTYPE)
+      << "Nested objects are freed by their owner";
+  ASSERT_EQ(QInfo_set_child(root, slot, qubit), QINFO_ERROR_INVALIDTYPE)
+      << "Object nested twice";
+  QInfo_index loop = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_add(qubit, "loop", QINFO_TYPE_QINFO,
+                                         &loop)))
+      << "Could not add";
+  ASSERT_EQ(QInfo_set_child(qubit, loop, root), QINFO_ERROR_INVALIDTYPE)
+      << "Cycle not detected";
+  ASSERT_EQ(QInfo_set_child(root, index, qubit), QINFO_ERROR_INVALIDTYPE)
+      << "Type mismatch not detected";
+
+  const char *const path[] = {"device", "qubit_17", "t1"};
+  QInfo leaf = nullptr;
+  double t1 = 0.0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query_path(root, 3, path, &leaf,
+                                                &index)))
+      << "Could not query path";
+  ASSERT_EQ(leaf, qubit) << "Wrong leaf";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_d(leaf, index, &t1)))
+      << "Could not get";
+  ASSERT_EQ(t1, 85.5) << "Wrong value";
+  QInfo_key keys[2];
+  QInfo_key_make("device", 6, &keys[0]);
+  QInfo_key_make("qubit_17", 8, &keys[1]);
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query_path_keys(root, 2, keys, &leaf,
+                                                     &index)))
+      << "Could not query path";
+  ASSERT_EQ(leaf, device) << "Wrong leaf";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_child(leaf, index, &child)))
+      << "Could not peek";
+  ASSERT_EQ(child, qubit) << "Wrong child";
+
+  const char *const missing[] = {"device", "qubit_3", "t1"};
+  const char *const unset[] = {"device", "unset", "t1"};
+  const char *const scalar[] = {"name", "t1"};
+  ASSERT_EQ(QInfo_query_path(root, 3, missing, &leaf, &index),
+            QINFO_WARN_NOKEY)
+      << "Missing key not detected";
+  ASSERT_EQ(QInfo_query_path(root, 3, unset, &leaf, &index),
+            QINFO_WARN_NOKEY)
+      << "Unset object not detected";
+  ASSERT_EQ(QInfo_query_path(root, 2, scalar, &leaf, &index),
+            QINFO_ERROR_INVALIDTYPE)
+      << "Type mismatch not detected";
+  ASSERT_EQ(QInfo_query_path(root, 0, path, &leaf, &index),
+            QINFO_ERROR_OUTOFBOUNDS)
+      << "Empty path not detected";
+
+  // Duplicates own duplicates of the nested objects.
+  QInfo copy = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_duplicate(root, &copy)))
+      << "Could not duplicate";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query_path(copy, 3, path, &leaf,
+                                                &index)))
+      << "Could not query path";
+  ASSERT_NE(leaf, qubit) << "Nested object shared by duplicate";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_set_d(leaf, index, 12.0)))
+      << "Could not set";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query_path(root, 3, path, &leaf,
+                                                &index)))
+      << "Could not query path";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_d(leaf, index, &t1)))
+      << "Could not get";
+  ASSERT_EQ(t1, 85.5) << "Original changed through duplicate";
+
+  // Serialization and merges keep the hierarchy.
+  size_t size = 0;
+  ASSERT_TRUE(QInfo_is_Success(QInfo_serialize(copy, nullptr, 0, &size)))
+      << "Could not size";
+  std::vector<char> buffer(size);
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_serialize(copy, buffer.data(), buffer.size(), &size)))
+      << "Could not serialize";
+  QInfo loaded = nullptr;
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_deserialize(buffer.data(), buffer.size(), &loaded)))
+      << "Could not deserialize";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query_path(loaded, 3, path, &leaf,
+                                                &index)))
+      << "Could not query path";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_d(leaf, index, &t1)))
+      << "Could not get";
+  ASSERT_EQ(t1, 12.0) << "Wrong value";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query_path(loaded, 2, unset, &leaf,
+                                                &index)))
+      << "Could not query path";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_peek_child(leaf, index, &child)))
+      << "Could not peek";
+  ASSERT_EQ(child, nullptr) << "Unset object not kept";
+  const char magic[] = {'Q', 'I', 'N', 'F'};
+  const auto nested =
+      std::search(buffer.begin() + 1, buffer.end(), magic, magic + 4);
+  ASSERT_NE(nested, buffer.end()) << "Nested object not serialized";
+  *nested = 'X';
+  QInfo corrupt = nullptr;
+  ASSERT_EQ(QInfo_deserialize(buffer.data(), buffer.size(), &corrupt),
+            QINFO_ERROR_INVALIDFORMAT)
+      << "Corrupt nested object not detected";
+
+  ASSERT_TRUE(QInfo_is_Success(
+      QInfo_merge(root, loaded, QINFO_MERGE_OVERWRITE)))
+      << "Could not merge";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(loaded))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query_path(root, 3, path, &leaf,
+                                                &index)))
+      << "Could not query path";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_get_val_d(leaf, index, &t1)))
+      << "Could not get";
+  ASSERT_EQ(t1, 12.0) << "Merge did not overwrite nested object";
+
+  QInfo_frozen frozen = nullptr;
+  ASSERT_EQ(QInfo_freeze(root, &frozen), QINFO_ERROR_INVALIDTYPE)
+      << "Nested objects cannot be frozen";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_query(copy, "device", &index)))
+      << "Could not query";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_remove(copy, index)))
+      << "Could not remove";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_clear(root))) << "Could not clear";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(copy))) << "Could not free";
+  ASSERT_TRUE(QInfo_is_Success(QInfo_free(root))) << "Could not free";
+}